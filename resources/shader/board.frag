@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 texCoord;
+in vec4 fragColor;
+out vec4 finalColor;
+
+uniform sampler2D tex;
+
+// a whole board on one quad, every texel is a cell and empty cells have alpha 0
+void main()
+{
+    vec4 cell = texture(tex, texCoord);
+    finalColor = cell * fragColor;
+}
@@ -1,18 +1,20 @@
 #version 330 core
 layout(location = 0) in vec2 position;
 
-uniform mat4 model;
+// per instance
+layout(location = 1) in vec3 instancePosition;
+layout(location = 2) in vec2 instanceSize;
+layout(location = 3) in vec4 instanceColor;
+layout(location = 4) in vec4 instanceUv; // (u0, v0, u1, v1)
+
 uniform mat4 view;
 uniform mat4 projection;
 
-uniform vec4 color;
-
 out vec4 fragColor;
 out vec2 texCoord;
 
 void main(){
-    fragColor = color;
-    texCoord = position.xy;
-    gl_Position = projection * view * model * vec4(position.x, position.y, 0.0, 1.0);
+    fragColor = instanceColor;
+    texCoord = mix(instanceUv.xy, instanceUv.zw, position);
+    gl_Position = projection * view * vec4(instancePosition + vec3(position * instanceSize, 0.0), 1.0);
 }
-
@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 texCoord;
+in vec4 fragColor;
+out vec4 finalColor;
+
+uniform sampler2D tex;
+
+// distance field glyphs, 0.5 on the outline and higher inside
+void main()
+{
+    float distance = texture(tex, texCoord).r;
+    // about one screen pixel of antialiasing whatever the glyph is scaled to
+    float width = max(fwidth(distance) * 0.7, 0.001);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    finalColor = vec4(fragColor.x, fragColor.y, fragColor.z, alpha);
+}
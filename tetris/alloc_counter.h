@@ -0,0 +1,12 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+using namespace std;
+
+// Calls to the global operator new since the program started, so benchmarks
+// can tell whether a code path touches the heap. The counting operator new
+// lives in alloc_counter.cpp, linked only into the tetris executable. Only
+// the plain operator new is replaced, aligned new for over-aligned types
+// and direct malloc calls are not counted.
+extern atomic<uint64_t> allocationCount;
@@ -0,0 +1,1340 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "alloc_counter.h"
+#include "tetris.h"
+#include "sim.h"
+#include "bot.h"
+#include "glyph_atlas.h"
+#include "glyph_rasterizer.h"
+#include "soft_renderer.h"
+#include "triple_buffer.h"
+#include "spsc_queue.h"
+#include "frame_stats.h"
+#include "frame_pacer.h"
+#include "fixed_timestep.h"
+#include "latency_trace.h"
+#include "frame_allocator.h"
+#include "text_renderer.h"
+
+using namespace std;
+
+// benchmark loops write their results here so the optimizer cannot drop them
+inline volatile uint32_t benchSink;
+
+inline uint32_t nextRandom(uint32_t &seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 16;
+}
+
+// feeds an arena the kind of input a player mashing keys would, from a fixed seed
+inline void stepArena(Arena &arena, uint32_t &seed)
+{
+    switch (nextRandom(seed) % 4)
+    {
+    case 0:
+        arena.moveHorizontal(true, false);
+        break;
+    case 1:
+        arena.moveHorizontal(false, true);
+        break;
+    case 2:
+        arena.rotate();
+        break;
+    default:
+        arena.moveDown();
+        break;
+    }
+}
+
+inline double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// the whole gameplay step (move, rotate, fall, place, clear, spawn) must stay off the heap
+inline bool benchStepPath(int steps)
+{
+    Arena arena(vec2(0.0f, 0.0f), 300, 1);
+    arena.moveDown();
+
+    uint32_t seed = 1;
+    uint64_t allocsBefore = allocationCount.load();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < steps; ++i)
+    {
+        stepArena(arena, seed);
+    }
+    double elapsed = secondsSince(start);
+    uint64_t allocs = allocationCount.load() - allocsBefore;
+
+    cout << "step path.........: " << steps << " steps, " << allocs << " allocations, "
+         << (uint64_t)(steps / elapsed) << " steps/sec" << endl;
+    return allocs == 0;
+}
+
+// removes one line at a time and shifts everything above it down, top line first
+inline void clearLinesOneByOne(BitBoard &board, RowSet lines)
+{
+    for (int y = 0; y < ARENA_SIZE_Y; ++y)
+    {
+        if (((lines >> y) & 1) == 0)
+            continue;
+        for (int i = y; i > 0; --i)
+        {
+            board.copyRow(i - 1, i);
+        }
+        board.clearRow(0);
+    }
+    board.rebuildColumns();
+}
+
+inline bool sameBoard(const BitBoard &a, const BitBoard &b)
+{
+    for (int x = 0; x < ARENA_SIZE_X; ++x)
+    {
+        if (a.columns[x] != b.columns[x])
+            return false;
+    }
+    for (int y = 0; y < ARENA_SIZE_Y; ++y)
+    {
+        if (a.placed[y] != b.placed[y] || a.filled[y] != b.filled[y])
+            return false;
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            if (a.colors[y][x] != b.colors[y][x])
+                return false;
+        }
+    }
+    return true;
+}
+
+inline BitBoard randomBoard(uint32_t &seed, RowSet &fullLines)
+{
+    BitBoard board;
+    fullLines = 0;
+    for (int y = 0; y < ARENA_SIZE_Y; ++y)
+    {
+        RowMask row = nextRandom(seed) % 3 == 0 ? ROW_FULL : (RowMask)(nextRandom(seed) & ROW_FULL);
+        board.placed[y] = board.filled[y] = row;
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            board.colors[y][x] = (row >> x) & 1 ? nextRandom(seed) : 0;
+        }
+        if (row == ROW_FULL)
+            fullLines |= 1u << y;
+    }
+    board.rebuildColumns();
+    return board;
+}
+
+// compaction must match the line by line reference for any set of cleared rows
+inline bool benchLineClears(int checks, int clears)
+{
+    uint32_t seed = 7;
+    int mismatches = 0;
+    for (int i = 0; i < checks; ++i)
+    {
+        RowSet fullLines;
+        BitBoard board = randomBoard(seed, fullLines);
+        BitBoard expected = board;
+        clearLinesOneByOne(expected, fullLines);
+        board.clearLines(fullLines);
+        if (!sameBoard(board, expected))
+            mismatches++;
+    }
+
+    const int boardCount = 256;
+    static BitBoard boards[boardCount];
+    static RowSet lines[boardCount];
+    for (int i = 0; i < boardCount; ++i)
+    {
+        boards[i] = randomBoard(seed, lines[i]);
+    }
+
+    // both loops pay for the same board copy, only the clear differs
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < clears; ++i)
+    {
+        BitBoard b = boards[i % boardCount];
+        b.clearLines(lines[i % boardCount]);
+        benchSink = b.placed[ARENA_SIZE_Y - 1];
+    }
+    double compactElapsed = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < clears; ++i)
+    {
+        BitBoard b = boards[i % boardCount];
+        clearLinesOneByOne(b, lines[i % boardCount]);
+        benchSink = b.placed[ARENA_SIZE_Y - 1];
+    }
+    double oneByOneElapsed = secondsSince(start);
+
+    cout << "line clears.......: " << checks << " random boards checked, " << mismatches << " mismatches" << endl;
+    cout << "line clears.......: " << (uint64_t)(clears / compactElapsed) << " clears/sec compacted, "
+         << (uint64_t)(clears / oneByOneElapsed) << " clears/sec line by line" << endl;
+    return mismatches == 0;
+}
+
+inline SimInput randomInput(uint32_t &seed)
+{
+    uint32_t r = nextRandom(seed);
+    return SimInput{(int)(r % 3) - 1, (r >> 2) % 8 == 0, ((r >> 5) & 1) == 1, (r >> 6) % 64 == 0};
+}
+
+// two simulations fed the same seed and inputs have to stay identical, tick for tick
+inline bool benchSimulation(int ticks)
+{
+    Simulation timed(42);
+    uint32_t inputSeed = 3;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ticks; ++i)
+    {
+        timed.step(randomInput(inputSeed));
+    }
+    double elapsed = secondsSince(start);
+
+    Simulation replay(42);
+    inputSeed = 3;
+    for (int i = 0; i < ticks; ++i)
+    {
+        replay.step(randomInput(inputSeed));
+    }
+    bool deterministic = sameBoard(timed.arena.board, replay.arena.board) &&
+                         timed.arena.selectedIndex == replay.arena.selectedIndex;
+
+    cout << "simulation........: " << ticks << " ticks, " << (uint64_t)(ticks / elapsed) << " ticks/sec, "
+         << (deterministic ? "deterministic" : "NOT deterministic") << endl;
+    return deterministic;
+}
+
+// the bot plays a full game per lookahead setting, placements/ms is the number to watch
+inline bool benchBot(BoardEvaluator *evaluator, const char *name, int pieces, int lookahead, double budgetMs)
+{
+    Arena arena(vec2(0.0f, 0.0f), 300, 5);
+    Bot bot(evaluator, lookahead, budgetMs);
+
+    uint64_t evaluated = 0;
+    int timeouts = 0;
+    double slowestMs = 0.0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < pieces; ++i)
+    {
+        auto thinkStart = chrono::steady_clock::now();
+        bot.play(arena);
+        slowestMs = std::max(slowestMs, secondsSince(thinkStart) * 1000.0);
+        evaluated += bot.evaluated;
+        timeouts += bot.outOfTime;
+    }
+    double elapsed = secondsSince(start);
+
+    cout << "bot " << name << " lookahead " << lookahead << "...: " << pieces << " pieces, " << (uint64_t)(evaluated / (elapsed * 1000.0))
+         << " placements/ms, slowest move " << slowestMs << " ms, " << timeouts << " moves over the "
+         << budgetMs << " ms budget" << endl;
+    return true;
+}
+
+// straight from the definitions in board_features.h, one cell at a time
+inline BoardFeatures boardFeaturesPerCell(const RowMask *rows)
+{
+    BoardFeatures f = {};
+    auto cell = [&](int x, int y) { return x < 0 || x >= ARENA_SIZE_X || ((rows[y] >> x) & 1); };
+    for (int x = 0; x < ARENA_SIZE_X; ++x)
+    {
+        int top = 0;
+        while (top < ARENA_SIZE_Y && !cell(x, top))
+        {
+            top++;
+        }
+        f.heights[x] = (uint16_t)(ARENA_SIZE_Y - top);
+        f.aggregateHeight += f.heights[x];
+        int depth = 0;
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            if (y > top && !cell(x, y))
+                f.holes++;
+            depth = y < top && cell(x - 1, y) && cell(x + 1, y) ? depth + 1 : 0;
+            f.wellDepth += depth;
+        }
+    }
+    for (int x = 0; x + 1 < ARENA_SIZE_X; ++x)
+    {
+        f.bumpiness += (uint16_t)abs(f.heights[x] - f.heights[x + 1]);
+    }
+    for (int y = 0; y < ARENA_SIZE_Y; ++y)
+    {
+        for (int x = 0; x <= ARENA_SIZE_X; ++x)
+        {
+            f.rowTransitions += cell(x - 1, y) != cell(x, y);
+        }
+    }
+    return f;
+}
+
+// boards shaped like real play, a ragged stack with a few holes
+inline void randomBatch(uint32_t &seed, BoardBatch &batch)
+{
+    for (int b = 0; b < BOARD_BATCH; ++b)
+    {
+        int stack = nextRandom(seed) % ARENA_SIZE_Y;
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            RowMask row = 0;
+            if (y >= ARENA_SIZE_Y - stack)
+                row = (RowMask)(nextRandom(seed) | nextRandom(seed)) & ROW_FULL;
+            else if (y + 3 >= ARENA_SIZE_Y - stack)
+                row = (RowMask)(nextRandom(seed) & nextRandom(seed)) & ROW_FULL;
+            batch.rows[y][b] = row;
+        }
+    }
+}
+
+inline bool sameFeatures(const BatchFeatures &f, int b, const BoardFeatures &g)
+{
+    for (int x = 0; x < ARENA_SIZE_X; ++x)
+    {
+        if (f.heights[x][b] != g.heights[x])
+            return false;
+    }
+    return f.aggregateHeight[b] == g.aggregateHeight && f.holes[b] == g.holes && f.bumpiness[b] == g.bumpiness &&
+           f.rowTransitions[b] == g.rowTransitions && f.wellDepth[b] == g.wellDepth;
+}
+
+inline bool benchBoardFeatures(int checks, int batchCount, int reps)
+{
+    uint32_t seed = 7;
+    int mismatches = 0;
+    for (int i = 0; i < checks; ++i)
+    {
+        BoardBatch batch;
+        randomBatch(seed, batch);
+        BatchFeatures scalar, simd;
+        computeFeaturesScalar(batch, scalar);
+        computeFeatures(batch, simd);
+        for (int b = 0; b < BOARD_BATCH; ++b)
+        {
+            RowMask rows[ARENA_SIZE_Y];
+            for (int y = 0; y < ARENA_SIZE_Y; ++y)
+            {
+                rows[y] = batch.rows[y][b];
+            }
+            BoardFeatures reference = boardFeaturesPerCell(rows);
+            if (!sameFeatures(scalar, b, reference) || !sameFeatures(simd, b, reference))
+                mismatches++;
+        }
+    }
+
+    vector<BoardBatch> batches(batchCount);
+    vector<BatchFeatures> out(batchCount);
+    for (BoardBatch &b : batches)
+    {
+        randomBatch(seed, b);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r)
+    {
+        for (int i = 0; i < batchCount; ++i)
+        {
+            computeFeaturesScalar(batches[i], out[i]);
+        }
+        benchSink = out[r % batchCount].holes[0];
+    }
+    double scalarTime = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r)
+    {
+        computeFeatures(batches.data(), out.data(), batchCount);
+        benchSink = out[r % batchCount].holes[0];
+    }
+    double simdTime = secondsSince(start);
+
+    double boards = (double)batchCount * BOARD_BATCH * reps;
+    cout << "board features: " << checks * BOARD_BATCH << " boards checked, " << mismatches << " mismatches, scalar "
+         << (uint64_t)(boards / scalarTime) << " boards/s, " << BOARD_FEATURES_SIMD << " "
+         << (uint64_t)(boards / simdTime) << " boards/s" << endl;
+    return mismatches == 0;
+}
+
+// the landing row by testing one row at a time, what moveDown would find
+inline int landingRowByCollision(const Arena &arena)
+{
+    ivec2 p = arena.selectedIndex;
+    while (!arena.board.collides(arena.selected->mask(), p + ivec2(0, 1)))
+    {
+        p.y++;
+    }
+    return p.y;
+}
+
+inline bool benchDropIndex(int steps)
+{
+    Arena arena(vec2(0.0f, 0.0f), 300, 9);
+    uint32_t seed = 9;
+    int mismatches = 0;
+    int checks = 0;
+    double indexTime = 0.0;
+    double collisionTime = 0.0;
+    for (int i = 0; i < steps; ++i)
+    {
+        if (nextRandom(seed) % 16 == 0)
+            arena.hardDrop();
+        else
+            stepArena(arena, seed);
+        if (!arena.selected)
+            continue;
+
+        auto start = chrono::steady_clock::now();
+        int indexed = 0;
+        for (int r = 0; r < 64; ++r)
+        {
+            indexed += arena.landingRow();
+        }
+        indexTime += secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        int collided = 0;
+        for (int r = 0; r < 64; ++r)
+        {
+            collided += landingRowByCollision(arena);
+        }
+        collisionTime += secondsSince(start);
+
+        mismatches += indexed != collided;
+        checks++;
+    }
+    for (int x = 0; x < ARENA_SIZE_X; ++x)
+    {
+        RowSet column = 0;
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            column |= (RowSet)arena.board.isPlaced(x, y) << y;
+        }
+        mismatches += column != arena.board.columns[x];
+    }
+
+    double queries = checks * 64.0;
+    cout << "drop index........: " << checks << " positions, " << mismatches << " mismatches, "
+         << (uint64_t)(queries / indexTime) << " landing rows/sec indexed, " << (uint64_t)(queries / collisionTime)
+         << " row by row" << endl;
+    return mismatches == 0;
+}
+
+inline bool benchZobrist(int steps)
+{
+    Arena arena(vec2(0.0f, 0.0f), 300, 3);
+    uint32_t seed = 3;
+    int mismatches = 0;
+    for (int i = 0; i < steps; ++i)
+    {
+        stepArena(arena, seed);
+        mismatches += arena.hash != arena.computeHash();
+    }
+    cout << "zobrist...........: " << steps << " steps, " << arena.piecesPlaced << " pieces, " << arena.linesCleared
+         << " lines, " << mismatches << " incremental hash mismatches" << endl;
+    return mismatches == 0;
+}
+
+// same game with and without the table, without a deadline both must play the same moves
+inline bool benchTranspositionTable(int pieces, int lookahead, size_t megabytes)
+{
+    HeuristicEvaluator evaluator;
+    TranspositionTable table(megabytes);
+    uint64_t hashes[2];
+    double elapsed[2];
+    for (int run = 0; run < 2; ++run)
+    {
+        Arena arena(vec2(0.0f, 0.0f), 300, 11);
+        Bot bot(&evaluator, lookahead, 60000.0);
+        bot.table = run == 1 ? &table : nullptr;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < pieces; ++i)
+        {
+            bot.play(arena);
+        }
+        elapsed[run] = secondsSince(start);
+        hashes[run] = arena.hash;
+    }
+
+    cout << "transposition.....: lookahead " << lookahead << ", " << table.bytes() / (1024 * 1024) << " MB, "
+         << pieces / elapsed[0] << " moves/s without, " << pieces / elapsed[1] << " moves/s with, hit rate "
+         << table.hitRate() * 100.0 << "%, " << table.replacements << " replacements, "
+         << (hashes[0] == hashes[1] ? "same moves" : "DIFFERENT moves") << endl;
+    return hashes[0] == hashes[1];
+}
+
+// height of a GlyphAtlas holding these glyphs, growing the way it does, 0 when they do not fit
+inline int atlasHeightFor(const vector<RasterizedGlyph> &glyphs)
+{
+    ShelfPacker packer(GLYPH_ATLAS_WIDTH, GLYPH_ATLAS_MIN_HEIGHT);
+    for (const RasterizedGlyph &g : glyphs)
+    {
+        if (g.width == 0 || g.height == 0)
+            continue;
+        ivec2 topLeft;
+        while (!packer.pack(g.width + GLYPH_ATLAS_PADDING, g.height + GLYPH_ATLAS_PADDING, topLeft))
+        {
+            if (packer.height * 2 > GLYPH_ATLAS_MAX_HEIGHT)
+                return 0;
+            packer.height *= 2;
+        }
+    }
+    return packer.height;
+}
+
+// printable ascii at every size the hud might use, bitmaps need a set per size
+// while distance fields are rasterized once
+inline bool benchGlyphAtlas(const vector<int> &sizes)
+{
+    string charset = GLYPH_PREWARM_CHARSET;
+    for (GlyphMode mode : {GLYPH_BITMAP, GLYPH_SDF})
+    {
+        GlyphRasterizer rasterizer(mode);
+        uint32_t font;
+        try
+        {
+            font = rasterizer.loadFont("resources/font/Roboto/Roboto-Regular.ttf");
+        }
+        catch (runtime_error &e)
+        {
+            cout << "glyph atlas.......: no font, run from the directory holding resources/" << endl;
+            return true;
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (int size : sizes)
+        {
+            for (char c : charset)
+            {
+                rasterizer.request(GlyphKey{font, mode == GLYPH_SDF ? GLYPH_SDF_SIZE : (uint32_t)size, (uint32_t)c});
+            }
+            if (mode == GLYPH_SDF)
+                break;
+        }
+        rasterizer.waitIdle();
+        double elapsed = secondsSince(start);
+
+        vector<RasterizedGlyph> glyphs;
+        rasterizer.takeFinished(glyphs);
+        size_t pixels = 0;
+        int failed = 0;
+        for (const RasterizedGlyph &g : glyphs)
+        {
+            pixels += g.pixels.size();
+            failed += !g.ok;
+        }
+        int height = atlasHeightFor(glyphs);
+
+        cout << "glyph atlas.......: " << (mode == GLYPH_SDF ? "sdf, any size" : "bitmap, ");
+        if (mode == GLYPH_BITMAP)
+            cout << sizes.size() << " sizes";
+        cout << ", " << glyphs.size() << " glyphs, " << failed << " failed, " << pixels / 1024 << " KB of pixels, ";
+        if (height == 0)
+            cout << "over the " << GLYPH_ATLAS_WIDTH << "x" << GLYPH_ATLAS_MAX_HEIGHT << " atlas limit";
+        else
+            cout << GLYPH_ATLAS_WIDTH << "x" << height << " atlas (" << GLYPH_ATLAS_WIDTH * height / 1024 << " KB)";
+        cout << ", rasterized in " << elapsed * 1000.0 << " ms" << endl;
+        if (failed != 0)
+            return false;
+    }
+    return true;
+}
+
+// A few sprites on a 16x16 framebuffer against pixels worked out by hand
+// from gl's rules: a solid quad, pixel centers right on the edges of a
+// quad at half pixel coordinates (left and bottom edges in, right and top
+// out), SRC_ALPHA, ONE_MINUS_SRC_ALPHA blending rounded like an RGBA8
+// target, and a made up glyph texture sampled on and between its texels.
+// Every other pixel has to keep the clear color.
+inline bool benchSoftwarePixels()
+{
+    const int size = 16;
+    mat4 ortho = glm::ortho(0.0f, (float)size, (float)size, 0.0f, 0.1f, 100.0f);
+    mat4 view = glm::translate(mat4(1.0), vec3(0.0f, 0.0f, -3.0f));
+    SoftRenderer renderer(size, size, 1);
+
+    // coverage like a glyph bitmap: a 2x2 checker and a 2x1 ramp from empty to full
+    vector<uint8_t> checker = {0, 255, 255, 0};
+    vector<uint8_t> ramp = {0, 255};
+    unsigned int checkerId = nextSoftTextureId();
+    unsigned int rampId = nextSoftTextureId();
+    renderer.bindTexture(checkerId, &checker, 2);
+    renderer.bindTexture(rampId, &ramp, 2);
+
+    vector<Sprite> sprites = {
+        Sprite{vec3(2.0f, 3.0f, 0.0f), vec2(4.0f, 5.0f), vec4(1.0f, 0.0f, 0.0f, 1.0f)},
+        Sprite{vec3(9.5f, 0.5f, 0.0f), vec2(2.0f, 2.0f), vec4(0.0f, 1.0f, 0.0f, 1.0f)},
+        Sprite{vec3(0.0f, 12.0f, 0.0f), vec2(2.0f, 2.0f), vec4(0.0f, 0.0f, 1.0f, 0.5f)},
+        Sprite{vec3(12.0f, 12.0f, 0.0f), vec2(2.0f, 2.0f), vec4(1.0f), checkerId},
+        Sprite{vec3(0.0f, 15.0f, 0.0f), vec2(4.0f, 1.0f), vec4(1.0f), rampId},
+    };
+    renderer.beginFrame(vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    renderer.render(sprites, view, ortho);
+    renderer.endFrame();
+
+    // 0xAABBGGRR
+    vector<uint32_t> expected(size * size, 0xFF000000u);
+    auto set = [&](int x, int y, uint32_t p) { expected[y * size + x] = p; };
+    for (int y = 3; y < 8; ++y)
+    {
+        for (int x = 2; x < 6; ++x)
+        {
+            set(x, y, 0xFF0000FFu);
+        }
+    }
+    // x 9.5 to 11.5 and y 0.5 to 2.5 (gl's top edge) hold the centers of columns 9, 10 and rows 1, 2
+    for (int y = 1; y < 3; ++y)
+    {
+        for (int x = 9; x < 11; ++x)
+        {
+            set(x, y, 0xFF00FF00u);
+        }
+    }
+    // alpha 0.5 is 128, blue 255 * 128 / 255 and alpha 128 * 128 / 255 + 255 * 127 / 255 = 191
+    for (int y = 12; y < 14; ++y)
+    {
+        for (int x = 0; x < 2; ++x)
+        {
+            set(x, y, 0xBF800000u);
+        }
+    }
+    // each pixel center is on a texel center, only the two full texels draw
+    set(13, 12, 0xFFFFFFFFu);
+    set(12, 13, 0xFFFFFFFFu);
+    // the ramp 4 pixels wide samples 0 (clamped), 0.25, 0.75 and 1 (clamped)
+    set(1, 15, 0xCF404040u);
+    set(2, 15, 0xCFBFBFBFu);
+    set(3, 15, 0xFFFFFFFFu);
+
+    int wrong = 0;
+    for (int i = 0; i < size * size; ++i)
+    {
+        wrong += renderer.pixels[i] != expected[i];
+    }
+    cout << "software pixels...: " << sprites.size() << " sprites on " << size << "x" << size << ", " << wrong
+         << " pixels off from gl's rules" << endl;
+    return wrong == 0;
+}
+
+// arena frames through the software rasterizer, striped over threads they
+// must come out exactly as they do on one thread
+inline bool benchSoftwareRaster(int frames, int threads)
+{
+    mat4 ortho = glm::ortho(0.0f, 800.0f, 800.0f, 0.0f, 0.1f, 100.0f);
+    mat4 view = glm::translate(mat4(1.0), vec3(0.0f, 0.0f, -3.0f));
+    SoftRenderer single(800, 800, 1);
+    SoftRenderer striped(800, 800, threads);
+    Arena arena(vec2(100, 0), 300, 5);
+    uint32_t seed = 5;
+    int mismatches = 0;
+    double elapsed[2] = {0.0, 0.0};
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        stepArena(arena, seed);
+        const vector<Sprite> &preview = arena.renderPreview();
+        const vector<Sprite> &cells = arena.render();
+        const vector<Sprite> &boundary = arena.renderBoundary();
+        SoftRenderer *renderers[2] = {&single, &striped};
+        for (int r = 0; r < 2; ++r)
+        {
+            auto start = chrono::steady_clock::now();
+            renderers[r]->beginFrame(vec4(0.2f, 0.3f, 0.3f, 1.0f));
+            renderers[r]->render(preview, view, ortho);
+            renderers[r]->render(cells, view, ortho);
+            renderers[r]->render(boundary, view, ortho);
+            renderers[r]->endFrame();
+            elapsed[r] += secondsSince(start);
+        }
+        mismatches += single.pixels != striped.pixels;
+    }
+    cout << "software raster...: " << frames << " 800x800 arena frames, " << frames / elapsed[0] << " fps on 1 thread, "
+         << frames / elapsed[1] << " fps on " << threads << ", " << mismatches << " mismatches" << endl;
+    return mismatches == 0;
+}
+
+// the preview, placed cells, falling block and ghost built from scratch, how Arena did it before it kept its lists
+inline vector<Sprite> arenaSpritesFromScratch(Arena &arena)
+{
+    vec2 blockSize = arena.getBlockSize();
+    vector<Sprite> sprites;
+    vec2 startPos = vec2(arena.position.x + arena.size.x, arena.position.y + blockSize.y);
+    for (int i = 0; i < arena.next.size(); ++i)
+    {
+        float lowestY = -numeric_limits<float>::infinity();
+        for (Sprite s : arena.next[i].render(blockSize))
+        {
+            s.position += vec3(startPos.x + blockSize.x * 2.0, startPos.y, 0.0);
+            sprites.push_back(s);
+            lowestY = std::max(lowestY, s.position.y + blockSize.y);
+        }
+        startPos.y = lowestY + blockSize.y;
+    }
+
+    vec2 origin = arena.gridOrigin();
+    for (int y = 0; y < ARENA_SIZE_Y; ++y)
+    {
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            if (arena.board.isPlaced(x, y))
+                sprites.push_back(Sprite{vec3(origin + vec2(x, y) * blockSize, 0.0), blockSize,
+                                         vec4(unpackColor(arena.board.colors[y][x]), SOLID)});
+        }
+    }
+    if (arena.selected)
+    {
+        for (const PieceCell &c : arena.selected->shape().cells)
+        {
+            vec2 cell = vec2(arena.selectedIndex.x + c.x, arena.selectedIndex.y + c.y);
+            sprites.push_back(
+                Sprite{vec3(origin + cell * blockSize, 0.0), blockSize, vec4(arena.selected->color, SOLID)});
+        }
+        int ghostY = arena.landingRow();
+        for (const PieceCell &c : arena.selected->shape().cells)
+        {
+            int x = arena.selectedIndex.x + c.x;
+            int y = ghostY + c.y;
+            if (!arena.board.isFilled(x, y))
+                sprites.push_back(Sprite{vec3(origin + vec2(x, y) * blockSize, 0.0), blockSize,
+                                         vec4(arena.selected->color, GHOST_ALPHA)});
+        }
+    }
+    return sprites;
+}
+
+inline bool sameSprites(const vector<Sprite> &a, const vector<Sprite> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].position != b[i].position || a[i].size != b[i].size || a[i].color != b[i].color ||
+            a[i].textureId != b[i].textureId || a[i].uv != b[i].uv)
+            return false;
+    }
+    return true;
+}
+
+// A spectator screen: every board gets a move on about one frame in four,
+// the cached lists must match building everything again every frame.
+inline bool benchSpriteCache(int boards, int frames)
+{
+    vector<Arena> arenas;
+    for (int b = 0; b < boards; ++b)
+    {
+        arenas.emplace_back(vec2(0.0f, 0.0f), 300, 20 + b);
+        arenas.back().moveDown();
+    }
+    uint32_t seed = 20;
+    int mismatches = 0;
+    double cachedTime = 0.0;
+    double scratchTime = 0.0;
+    uint64_t regeneratedBefore = 0;
+    for (Arena &arena : arenas)
+    {
+        regeneratedBefore += arena.spritesRegenerated;
+    }
+
+    vector<Sprite> cached;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        for (Arena &arena : arenas)
+        {
+            if (nextRandom(seed) % 4 == 0)
+                stepArena(arena, seed);
+            if (frame % 97 == 0)
+                arena.position.x = (float)(frame % 2); // a layout change now and then
+        }
+
+        auto start = chrono::steady_clock::now();
+        size_t sprites = 0;
+        for (Arena &arena : arenas)
+        {
+            sprites += arena.renderPreview().size() + arena.render().size() + arena.renderBoundary().size();
+        }
+        cachedTime += secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        for (Arena &arena : arenas)
+        {
+            sprites += arenaSpritesFromScratch(arena).size() + 3;
+        }
+        scratchTime += secondsSince(start);
+        benchSink = (uint32_t)sprites;
+
+        for (Arena &arena : arenas)
+        {
+            const vector<Sprite> &preview = arena.renderPreview();
+            const vector<Sprite> &cells = arena.render();
+            cached.assign(preview.begin(), preview.end());
+            cached.insert(cached.end(), cells.begin(), cells.end());
+            mismatches += !sameSprites(cached, arenaSpritesFromScratch(arena));
+        }
+    }
+
+    uint64_t regenerated = 0;
+    for (Arena &arena : arenas)
+    {
+        regenerated += arena.spritesRegenerated;
+    }
+    regenerated -= regeneratedBefore;
+    cout << "sprite cache......: " << boards << " boards, " << (double)regenerated / frames
+         << " sprites regenerated per frame, " << mismatches << " mismatches, " << cachedTime * 1e6 / frames
+         << " us per frame cached, " << scratchTime * 1e6 / frames << " us from scratch" << endl;
+    return mismatches == 0;
+}
+
+// every word equal to the sequence number, so a value torn between two publishes shows
+struct HandoffValue
+{
+    uint64_t words[64];
+};
+
+// A writer thread publishes numbered values as fast as it can while the
+// reader fetches them, then the same numbers go through an SpscQueue. The
+// reader must never see a torn value or a number going backwards, and the
+// queue must deliver every number in order.
+inline bool benchFrameHandoff(uint64_t values)
+{
+    TripleBuffer<HandoffValue> buffer;
+    for (uint64_t w = 0; w < 64; ++w)
+    {
+        buffer.writeBuffer().words[w] = 0;
+    }
+    buffer.publish();
+
+    int torn = 0;
+    int backwards = 0;
+    uint64_t fetched = 0;
+    auto start = chrono::steady_clock::now();
+    thread writer([&] {
+        for (uint64_t n = 1; n <= values; ++n)
+        {
+            HandoffValue &v = buffer.writeBuffer();
+            for (uint64_t &word : v.words)
+            {
+                word = n;
+            }
+            buffer.publish();
+            // on a single core the reader only gets to run between publishes if we let it
+            if (n % 256 == 0)
+                this_thread::yield();
+        }
+    });
+    uint64_t last = 0;
+    while (last != values)
+    {
+        if (!buffer.fetch())
+        {
+            this_thread::yield();
+            continue;
+        }
+        const HandoffValue &v = buffer.readBuffer();
+        for (uint64_t word : v.words)
+        {
+            torn += word != v.words[0];
+        }
+        backwards += v.words[0] < last;
+        last = v.words[0];
+        fetched++;
+    }
+    writer.join();
+    double tripleTime = secondsSince(start);
+
+    static SpscQueue<uint64_t, 1024> queue;
+    int outOfOrder = 0;
+    start = chrono::steady_clock::now();
+    thread producer([&] {
+        for (uint64_t n = 1; n <= values; ++n)
+        {
+            while (!queue.push(n))
+            {
+                this_thread::yield();
+            }
+        }
+    });
+    for (uint64_t expected = 1; expected <= values;)
+    {
+        uint64_t n;
+        if (!queue.pop(n))
+        {
+            this_thread::yield();
+            continue;
+        }
+        outOfOrder += n != expected;
+        expected = n + 1;
+    }
+    producer.join();
+    double queueTime = secondsSince(start);
+
+    cout << "frame handoff.....: " << values << " values, " << fetched << " fetched, " << torn << " torn, "
+         << backwards << " backwards, " << (uint64_t)(values / tripleTime) << " publishes/sec, queue "
+         << (uint64_t)(values / queueTime) << " events/sec, " << outOfOrder << " out of order" << endl;
+    return torn == 0 && backwards == 0 && outOfOrder == 0;
+}
+
+// Capped pacing with the wait only sleeping and with it sleeping then
+// spinning, each frame doing a little work first. Reports how far the frame
+// intervals land from the target, how busy the process was and the spin
+// margin the pacer settled on.
+inline bool benchFramePacing(double fps, int frames)
+{
+    struct Variant
+    {
+        const char *name;
+        double spinSeconds;
+    };
+    const Variant variants[] = {{"sleep", 0.0}, {"sleep+spin", FRAME_PACER_SPIN}};
+    for (const Variant &v : variants)
+    {
+        FramePacer pacer(PACING_CAPPED, fps, v.spinSeconds);
+        FrameTimeStats error;
+        double cpuStart = processCpuSeconds();
+        double start = FramePacer::now();
+        double last = start;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            double work = FramePacer::now() + 0.0005;
+            while (FramePacer::now() < work)
+            {
+            }
+            pacer.wait();
+            double t = FramePacer::now();
+            error.add(fabs(t - last - pacer.interval) * 1000.0);
+            last = t;
+        }
+        double cpu = (processCpuSeconds() - cpuStart) / (FramePacer::now() - start);
+        FrameTimeSummary s = error.take();
+        cout << "frame pacing......: " << fps << " fps " << v.name << ", interval error p50 " << s.p50Ms << " ms p99 "
+             << s.p99Ms << " ms, cpu " << (int)(cpu * 100.0) << "%, spin margin " << pacer.spinSeconds * 1000.0
+             << " ms" << endl;
+    }
+    return true;
+}
+
+// key presses a few ms to a quarter second apart, each held up to a third of a second
+inline vector<InputEvent> scriptedInput(uint32_t seed, int64_t endMicros)
+{
+    vector<InputEvent> script;
+    // nextRandom gives 16 bits, milliseconds and microseconds are drawn apart
+    auto randomMicros = [&](int64_t mostMs) {
+        int64_t ms = nextRandom(seed) % mostMs;
+        return ms * 1000 + nextRandom(seed) % 1000;
+    };
+    for (int64_t time = 0; time < endMicros; time += 1 + randomMicros(250))
+    {
+        InputKey key = (InputKey)(nextRandom(seed) % INPUT_PAUSE);
+        script.push_back({key, true, time});
+        script.push_back({key, false, time + 1 + randomMicros(330)});
+    }
+    stable_sort(script.begin(), script.end(), [](const InputEvent &a, const InputEvent &b) { return a.time < b.time; });
+    return script;
+}
+
+// A scripted player, the same key events at the same times, driven through
+// the fixed timestep by very different frame times. Every run has to end on
+// the same board. Then a long stall must only run the catch up cap and
+// count the rest as dropped, and fast forward shows how fast ticks go when
+// nothing waits for the clock.
+inline bool benchFixedTimestep(int ticks)
+{
+    vector<InputEvent> script = scriptedInput(11, tickStartMicros(ticks));
+
+    // frame times in seconds, the jittery one from a fixed seed
+    auto play = [&](auto frameSeconds, Arena &arena) {
+        PlayerInput input(&arena);
+        arena.moveDown(); // force to spawn
+        FixedTimestep timestep(1.0 / SIM_TICKS_PER_SECOND);
+        size_t next = 0;
+        int tick = 0;
+        while (tick < ticks)
+        {
+            int due = timestep.advance(frameSeconds());
+            for (int i = 0; i < due && tick < ticks; ++i, ++tick)
+            {
+                for (; next < script.size() && script[next].time < input.tickEndMicros(); ++next)
+                {
+                    input.apply(script[next]);
+                }
+                input.tick();
+            }
+        }
+        return timestep.droppedTicks;
+    };
+
+    struct Pattern
+    {
+        const char *name;
+        function<double()> frameSeconds;
+    };
+    uint32_t jitterSeed = 5;
+    const Pattern patterns[] = {
+        {"60 Hz", [] { return 1.0 / 60.0; }},
+        {"144 Hz", [] { return 1.0 / 144.0; }},
+        {"jitter", [&] { return (1 + nextRandom(jitterSeed) % 40) * 0.001; }},
+    };
+    Arena reference(vec2(0.0f, 0.0f), 300, 7);
+    play([] { return 1.0 / SIM_TICKS_PER_SECOND; }, reference);
+    bool same = true;
+    uint64_t dropped = 0;
+    for (const Pattern &pattern : patterns)
+    {
+        Arena arena(vec2(0.0f, 0.0f), 300, 7);
+        dropped += play(pattern.frameSeconds, arena);
+        same &= sameBoard(arena.board, reference.board) && arena.selectedIndex == reference.selectedIndex;
+    }
+
+    FixedTimestep stalled(1.0 / SIM_TICKS_PER_SECOND);
+    int stallTicks = stalled.advance(2.0);
+    bool capped = stallTicks == FIXED_TIMESTEP_MAX_CATCH_UP &&
+                  stalled.droppedTicks == (uint64_t)(2 * SIM_TICKS_PER_SECOND - FIXED_TIMESTEP_MAX_CATCH_UP);
+
+    Arena arena(vec2(0.0f, 0.0f), 300, 7);
+    auto start = chrono::steady_clock::now();
+    FixedTimestep fast(1.0 / SIM_TICKS_PER_SECOND, FIXED_TIMESTEP_MAX_CATCH_UP, true);
+    PlayerInput input(&arena);
+    arena.moveDown();
+    while (fast.ticks < (uint64_t)ticks * 10)
+    {
+        int due = fast.advance(0.0);
+        for (int i = 0; i < due; ++i)
+        {
+            input.tick();
+        }
+    }
+    double elapsed = secondsSince(start);
+
+    cout << "fixed timestep....: " << ticks << " ticks at 60 Hz, 144 Hz and jittery frames "
+         << (same && dropped == 0 ? "in lockstep" : "NOT in lockstep") << ", 2 s stall ran " << stallTicks
+         << " ticks and dropped " << stalled.droppedTicks << ", fast forward " << (uint64_t)(fast.ticks / elapsed)
+         << " ticks/sec" << endl;
+    return same && dropped == 0 && capped;
+}
+
+// Key holds and taps that start anywhere inside a tick. A hold has to move
+// once on the press and then once for every repeat due before the release,
+// counted from the press itself rather than from the tick or frame it came
+// in, and two taps inside one tick have to move twice.
+inline bool benchInputTiming(int holds)
+{
+    const int64_t firstSticky = secondsToMicros(moveTickFirstSticky);
+    const int64_t repeat = secondsToMicros(moveTickTime);
+    const int64_t tickMicros = tickStartMicros(1);
+    uint32_t seed = 17;
+    int wrong = 0;
+    for (int i = 0; i < holds; ++i)
+    {
+        Arena arena(vec2(0.0f, 0.0f), 300, 7);
+        arena.moveDown(); // force to spawn
+        PlayerInput input(&arena);
+        int startX = arena.selectedIndex.x;
+
+        int64_t press = tickStartMicros(1 + nextRandom(seed) % 4);
+        press += nextRandom(seed) % tickMicros;
+        // up to two repeats, the piece has room for three moves from the spawn
+        int64_t hold = (nextRandom(seed) % ((firstSticky + repeat + repeat / 2) / 1000)) * 1000;
+        hold += 1 + nextRandom(seed) % 1000;
+        int expected = 1 + (hold > firstSticky ? (int)((hold - firstSticky - 1) / repeat) + 1 : 0);
+        InputEvent events[] = {{INPUT_LEFT, true, press}, {INPUT_LEFT, false, press + hold}};
+        int next = 0;
+        while (input.tickEndMicros() <= press + hold + tickMicros)
+        {
+            for (; next < 2 && events[next].time < input.tickEndMicros(); ++next)
+            {
+                input.apply(events[next]);
+            }
+            input.tick();
+        }
+        wrong += startX - arena.selectedIndex.x != expected;
+    }
+
+    Arena arena(vec2(0.0f, 0.0f), 300, 7);
+    arena.moveDown();
+    PlayerInput input(&arena);
+    int startX = arena.selectedIndex.x;
+    int64_t t = tickStartMicros(3) + 1000;
+    InputEvent taps[] = {{INPUT_RIGHT, true, t}, {INPUT_RIGHT, false, t + 2000}, {INPUT_RIGHT, true, t + 4000},
+                         {INPUT_RIGHT, false, t + 6000}};
+    while (input.ticks < 3)
+    {
+        input.tick();
+    }
+    for (const InputEvent &e : taps)
+    {
+        input.apply(e);
+    }
+    input.tick();
+    int tapMoves = arena.selectedIndex.x - startX;
+
+    cout << "input timing......: " << holds << " holds pressed mid tick, " << wrong
+         << " wrong move counts, two taps in one tick moved " << tapMoves << endl;
+    return wrong == 0 && tapMoves == 2;
+}
+
+// latency percentiles from the fixed buckets against exact ones from the
+// sorted samples, they may only differ by a bucket's width
+inline bool benchLatencyHistogram(int samples)
+{
+    uint32_t seed = 23;
+    LatencyHistogram histogram;
+    FrameTimeStats exact(samples);
+    vector<double> values;
+    for (int i = 0; i < samples; ++i)
+    {
+        // mostly a frame or two, with a long tail
+        double ms = (nextRandom(seed) % 4000) * 0.01;
+        if (nextRandom(seed) % 50 == 0)
+            ms += (nextRandom(seed) % 20000) * 0.01;
+        values.push_back(ms);
+        exact.add(ms);
+    }
+    auto start = chrono::steady_clock::now();
+    for (double ms : values)
+    {
+        histogram.add(ms);
+    }
+    double elapsed = secondsSince(start);
+    FrameTimeSummary s = exact.take();
+    double p50Error = fabs(histogram.percentile(0.5) - s.p50Ms);
+    double p99Error = fabs(histogram.percentile(0.99) - s.p99Ms);
+    bool ok = p50Error <= LATENCY_HISTOGRAM_BUCKET_MS && p99Error <= LATENCY_HISTOGRAM_BUCKET_MS &&
+              histogram.count == (uint64_t)samples;
+    cout << "latency histogram.: " << samples << " samples, p50 off by " << p50Error << " ms, p99 off by " << p99Error
+         << " ms, " << elapsed * 1e9 / samples << " ns per sample" << endl;
+    return ok;
+}
+
+// The sprites of a frame as Tetris::run builds them, through both its per
+// cell and its board texture branch with the debug overlay on, each once
+// with the lists in the FrameAllocator as run() does and once with them in
+// fresh vectors. Counts operator new calls per frame once things settled.
+// Draws go to a SoftRenderer, so this covers the sprite lists and the text
+// layout but not the GL side: SpriteRenderer's StreamBuffer and
+// BoardTexture::update have buffers of their own that are not measured.
+inline bool benchFrameAllocations(int frames)
+{
+    mat4 ortho = glm::ortho(0.0f, 800.0f, 800.0f, 0.0f, 0.1f, 100.0f);
+    mat4 view = glm::translate(mat4(1.0), vec3(0.0f, 0.0f, -3.0f));
+    SoftRenderer renderer(800, 800, 1);
+    TextRenderer textRenderer("resources/font/Roboto/Roboto-Regular.ttf", GLYPH_BITMAP, RENDER_SOFTWARE);
+    TextObject label(&textRenderer, vec3(300.0f, 300.0f, 0.0f), vec3(1.0, 1.0, 1.0));
+    label.setText("abcdefghijk");
+    textRenderer.prewarm(GLYPH_PREWARM_CHARSET, 20);
+    textRenderer.waitForGlyphs();
+    FrameAllocator frame;
+
+    auto run = [&](bool boardTexture, bool framed) {
+        Arena sim(vec2(100, 0), 300, 3);
+        Arena shown(vec2(100, 0), 300, 3);
+        sim.moveDown();
+        ArenaSnapshot snapshot;
+        uint32_t seed = 3;
+        uint64_t allocations = 0;
+        uint64_t frameAllocations = 0;
+        uint64_t maxFrameAllocations = 0;
+        textRenderer.runCache.clear();
+        for (int f = 0; f < frames; ++f)
+        {
+            if (f % 3 == 0)
+            {
+                stepArena(sim, seed);
+                sim.saveSnapshot(snapshot);
+                shown.loadSnapshot(snapshot);
+            }
+            vec2 offset = vec2(0.0f, (float)(f % 8));
+
+            uint64_t before = allocationCount.load(memory_order_relaxed);
+            textRenderer.beginFrame();
+            renderer.beginFrame(vec4(0.2f, 0.3f, 0.3f, 1.0f));
+            renderer.render(shown.renderPreview(), view, ortho);
+            if (boardTexture)
+            {
+                const vector<Sprite> &ghost = shown.renderGhost();
+                const vector<Sprite> &falling = shown.renderFalling(offset);
+                if (framed)
+                {
+                    span<Sprite> board = frame.allocate<Sprite>(ghost.size() + falling.size() + 1);
+                    auto out = copy(ghost.begin(), ghost.end(), board.begin());
+                    out = copy(falling.begin(), falling.end(), out);
+                    *out = shown.renderBoard(1);
+                    renderer.render(board, view, ortho);
+                }
+                else
+                {
+                    vector<Sprite> board = ghost;
+                    board.insert(board.end(), falling.begin(), falling.end());
+                    board.push_back(shown.renderBoard(1));
+                    renderer.render(board, view, ortho);
+                }
+            }
+            else
+            {
+                renderer.render(shown.render(offset), view, ortho);
+            }
+            renderer.render(shown.renderBoundary(), view, ortho);
+            renderer.render(label.sprites(), view, ortho);
+
+            // the same two overlay lines, the latency numbers stay at zero here
+            char overlay[128];
+            snprintf(overlay, sizeof(overlay), "%llu allocs last frame, %llu max this second, frame memory %zu of %zu KB",
+                     (unsigned long long)frameAllocations, (unsigned long long)maxFrameAllocations,
+                     frame.highWater / 1024, frame.size() / 1024);
+            vec3 firstLine = vec3(10.0f, 30.0f, 0.0f);
+            if (framed)
+                renderer.render(textRenderer.layoutTextCached(frame, firstLine, overlay, vec3(1.0f), 20), view, ortho);
+            else
+                renderer.render(textRenderer.layoutText(firstLine, overlay, vec3(1.0f), 20), view, ortho);
+            snprintf(overlay, sizeof(overlay), "key to swap p50 %.2f p99 %.2f ms, text runs %zu cached", 0.0, 0.0,
+                     textRenderer.runCache.size());
+            vec3 secondLine = vec3(10.0f, 56.0f, 0.0f);
+            if (framed)
+                renderer.render(textRenderer.layoutTextCached(frame, secondLine, overlay, vec3(1.0f), 20), view, ortho);
+            else
+                renderer.render(textRenderer.layoutText(secondLine, overlay, vec3(1.0f), 20), view, ortho);
+
+            frame.reset();
+            frameAllocations = allocationCount.load(memory_order_relaxed) - before;
+            maxFrameAllocations = std::max(maxFrameAllocations, frameAllocations);
+            if (f % 60 == 0)
+                maxFrameAllocations = 0;
+            if (f >= frames / 10)
+                allocations += frameAllocations;
+        }
+        return (double)allocations / (frames - frames / 10);
+    };
+
+    double cellVectors = run(false, false);
+    double cellFramed = run(false, true);
+    double boardVectors = run(true, false);
+    double boardFramed = run(true, true);
+    cout << "frame allocations.: " << frames << " frames, allocs/frame per cell " << cellVectors << " with vectors, "
+         << cellFramed << " with the frame allocator, board texture " << boardVectors << " with vectors, "
+         << boardFramed << " with the frame allocator, " << frame.highWater << " of " << frame.size()
+         << " bytes used" << endl;
+    return cellFramed == 0.0 && boardFramed == 0.0;
+}
+
+// The text run cache on its own with made up runs: hits, misses, the
+// least recently used run going first once the sprite budget is exceeded,
+// and a run from an older atlas generation missing. Then through
+// TextRenderer, a cached layout has to equal a fresh one, and a run the
+// cache evicts later in the same frame has to stay readable.
+inline bool benchTextRunCache(int lookups)
+{
+    bool ok = true;
+    auto run = [](int sprites) { return vector<Sprite>(sprites, Sprite{vec3(0.0f), vec2(1.0f), vec4(1.0f)}); };
+    auto key = [](const char *text) { return TextRunKey{text, 0, 20, vec3(1.0f), vec3(0.0f)}; };
+    auto find = [](TextRunCache &cache, const char *text, uint64_t generation) {
+        return cache.find(text, 0, 20, vec3(1.0f), vec3(0.0f), generation) != nullptr;
+    };
+    TextRunCache cache(10);
+    cache.put(key("a"), 0, run(4));
+    cache.put(key("b"), 0, run(4));
+    ok &= find(cache, "a", 0);  // a is now the most recently used
+    ok &= !find(cache, "x", 0); // never put
+    cache.put(key("c"), 0, run(4));
+    ok &= cache.evictions == 1 && cache.spriteCount == 8;
+    ok &= !find(cache, "b", 0) && find(cache, "a", 0) && find(cache, "c", 0);
+    ok &= !find(cache, "a", 1); // laid out against an older atlas
+    ok &= cache.hits == 3 && cache.misses == 3;
+
+    TextRenderer textRenderer("resources/font/Roboto/Roboto-Regular.ttf", GLYPH_BITMAP, RENDER_SOFTWARE);
+    textRenderer.prewarm("0123456789 abcdefghijklmnopqrstuvwxyz", 20);
+    textRenderer.waitForGlyphs();
+    FrameAllocator frame;
+    vec3 origin = vec3(10.0f, 30.0f, 0.0f);
+    auto same = [](span<const Sprite> a, const vector<Sprite> &b) { return sameSprites(vector<Sprite>(a.begin(), a.end()), b); };
+
+    vector<Sprite> fresh = textRenderer.layoutText(origin, "score 1234", vec3(1.0f), 20);
+    textRenderer.layoutTextCached(frame, origin, "score 1234", vec3(1.0f), 20);
+    uint64_t hitsBefore = textRenderer.runCache.hits;
+    span<const Sprite> cached = textRenderer.layoutTextCached(frame, origin, "score 1234", vec3(1.0f), 20);
+    ok &= textRenderer.runCache.hits == hitsBefore + 1 && same(cached, fresh);
+
+    // room for one run only, the second one evicts the first while it is still in use
+    textRenderer.runCache.maxSprites = fresh.size();
+    span<const Sprite> other = textRenderer.layoutTextCached(frame, origin, "level 5", vec3(1.0f), 20);
+    ok &= textRenderer.runCache.size() == 1 && same(cached, fresh) &&
+          same(other, textRenderer.layoutText(origin, "level 5", vec3(1.0f), 20));
+    textRenderer.runCache.maxSprites = TEXT_RUN_CACHE_MAX_SPRITES;
+    frame.reset();
+
+    // HUD lines that mostly stay the same, timed from the cache and laid out every time
+    const char *lines[] = {"score 1234", "level 5", "lines 42", "player one", "player two", "pieces 310"};
+    for (const char *line : lines)
+    {
+        textRenderer.layoutTextCached(frame, origin, line, vec3(1.0f), 20);
+    }
+    frame.reset();
+    uint64_t missesBefore = textRenderer.runCache.misses;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < lookups; ++i)
+    {
+        benchSink = (uint32_t)textRenderer.layoutTextCached(frame, origin, lines[i % 6], vec3(1.0f), 20).size();
+        if (i % 6 == 5)
+            frame.reset();
+    }
+    double cachedSeconds = secondsSince(start);
+    uint64_t misses = textRenderer.runCache.misses - missesBefore;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < lookups; ++i)
+    {
+        benchSink = (uint32_t)textRenderer.layoutText(frame, origin, lines[i % 6], vec3(1.0f), 20).size();
+        if (i % 6 == 5)
+            frame.reset();
+    }
+    double layoutSeconds = secondsSince(start);
+    frame.reset();
+
+    // new glyphs landing move the atlas on, every cached run has to be laid out again
+    textRenderer.prewarm("ABC", 20);
+    textRenderer.waitForGlyphs();
+    missesBefore = textRenderer.runCache.misses;
+    textRenderer.layoutTextCached(frame, origin, "score 1234", vec3(1.0f), 20);
+    ok &= textRenderer.runCache.misses == missesBefore + 1;
+    frame.reset();
+
+    cout << "text run cache....: " << (ok ? "lru, budget and generation checks pass" : "CHECKS FAILED") << ", "
+         << misses << " misses in " << lookups << " lookups, " << cachedSeconds * 1e9 / lookups << " ns cached, "
+         << layoutSeconds * 1e9 / lookups << " ns laid out" << endl;
+    return ok && misses == 0;
+}
+
+inline int runBenchmarks()
+{
+    bool ok = true;
+    ok &= benchStepPath(100000);
+    ok &= benchLineClears(10000, 1000000);
+    ok &= benchSimulation(1000000);
+    ok &= benchBoardFeatures(1000, 256, 200);
+    ok &= benchDropIndex(100000);
+    ok &= benchZobrist(200000);
+    ok &= benchTranspositionTable(20, 3, 4);
+    ok &= benchGlyphAtlas({12, 16, 20, 24, 32, 48, 64, 96});
+    ok &= benchTextRunCache(600000);
+    ok &= benchSoftwarePixels();
+    ok &= benchSoftwareRaster(500, (int)std::max(2u, thread::hardware_concurrency()));
+    ok &= benchSpriteCache(16, 5000);
+    ok &= benchFrameHandoff(1000000);
+    ok &= benchFramePacing(240.0, 240);
+    ok &= benchFixedTimestep(20000);
+    ok &= benchInputTiming(10000);
+    ok &= benchLatencyHistogram(100000);
+    ok &= benchFrameAllocations(5000);
+
+    HeuristicEvaluator heuristic;
+    FeatureEvaluator features;
+    ok &= benchBot(&heuristic, "heuristic", 500, 0, 4.0);
+    ok &= benchBot(&heuristic, "heuristic", 500, 1, 4.0);
+    ok &= benchBot(&heuristic, "heuristic", 100, 2, 4.0);
+    ok &= benchBot(&features, "features", 500, 1, 4.0);
+    ok &= benchBot(&features, "features", 100, 2, 4.0);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <bit>
+#include <stdint.h>
+
+using namespace std;
+using namespace glm;
+
+#define ARENA_SIZE_X 10
+#define ARENA_SIZE_Y 24
+
+// one bit per column, bit x = column x
+typedef uint16_t RowMask;
+#define ROW_FULL ((RowMask)((1u << ARENA_SIZE_X) - 1))
+
+// one bit per row, bit y = row y
+typedef uint32_t RowSet;
+
+// std::popcount becomes a library call unless the build targets a popcnt capable cpu
+struct RowPopcountTable
+{
+    uint8_t counts[1 << ARENA_SIZE_X];
+
+    constexpr RowPopcountTable() : counts()
+    {
+        for (int i = 0; i < (1 << ARENA_SIZE_X); ++i)
+        {
+            counts[i] = (uint8_t)((i & 1) + counts[i >> 1]);
+        }
+    }
+};
+constexpr RowPopcountTable ROW_POPCOUNT;
+
+inline int rowPopcount(RowMask row)
+{
+    return ROW_POPCOUNT.counts[row & ROW_FULL];
+}
+
+// piece shapes are at most 4x4, rows[i] bit j = template cell [i][j]
+struct PieceMask
+{
+    uint8_t rows[4];
+};
+
+// colors are kept as RGB8, which is exactly what Block::randomOne generates
+inline uint32_t packColor(vec3 c)
+{
+    uint32_t r = (uint32_t)(c.x * 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(c.y * 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(c.z * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16);
+}
+
+inline vec3 unpackColor(uint32_t c)
+{
+    return vec3(
+        (float)(c & 0xff) / 255,
+        (float)((c >> 8) & 0xff) / 255,
+        (float)((c >> 16) & 0xff) / 255);
+}
+
+class BitBoard
+{
+public:
+    // placed : cells locked into the arena
+    // filled : placed cells plus the currently falling block
+    RowMask placed[ARENA_SIZE_Y];
+    RowMask filled[ARENA_SIZE_Y];
+    uint32_t colors[ARENA_SIZE_Y][ARENA_SIZE_X];
+
+    // placed, transposed : bit y of columns[x] is set when (x, y) is placed,
+    // kept up to date by place() and clearLines() for constant time drop queries
+    RowSet columns[ARENA_SIZE_X];
+
+    // rows whose placed cells changed since the last takeDirtyRows(), the
+    // falling block moving through a row does not count
+    RowSet dirtyRows = 0;
+
+    BitBoard()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < ARENA_SIZE_Y; ++i)
+        {
+            clearRow(i);
+        }
+        rebuildColumns();
+    }
+
+    // for code that writes placed[] directly
+    void rebuildColumns()
+    {
+        dirtyRows = ((RowSet)1 << ARENA_SIZE_Y) - 1;
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            columns[x] = 0;
+        }
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            setColumnBits(y, placed[y]);
+        }
+    }
+
+    // piece rows are shifted into a 32 bit lane with 4 wall columns on the left,
+    // so stepping out of the arena on either side is just another set bit.
+    static bool shiftPieceRow(uint8_t pieceRow, int x, uint32_t &shifted)
+    {
+        if (x < -4)
+            return false;
+        shifted = (uint32_t)pieceRow << (x + 4);
+        return true;
+    }
+
+    bool collides(const PieceMask &piece, ivec2 topLeft) const
+    {
+        const uint32_t walls = ~((uint32_t)ROW_FULL << 4);
+        for (int i = 0; i < 4; ++i)
+        {
+            if (piece.rows[i] == 0)
+                continue;
+            int y = topLeft.y + i;
+            uint32_t row;
+            if (y < 0 || y >= ARENA_SIZE_Y || !shiftPieceRow(piece.rows[i], topLeft.x, row))
+                return true;
+            if (row & (walls | ((uint32_t)placed[y] << 4)))
+                return true;
+        }
+        return false;
+    }
+
+    // callers must have checked collides() first, the piece is assumed to be in bounds
+    static RowMask pieceRowAt(const PieceMask &piece, int i, int x)
+    {
+        return (RowMask)(x >= 0 ? piece.rows[i] << x : piece.rows[i] >> -x);
+    }
+
+    void fill(const PieceMask &piece, ivec2 topLeft, uint32_t color)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            RowMask m = pieceRowAt(piece, i, topLeft.x);
+            if (m == 0)
+                continue;
+            int y = topLeft.y + i;
+            filled[y] |= m;
+            paintRow(y, m, color);
+        }
+    }
+
+    void unfill(const PieceMask &piece, ivec2 topLeft)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            RowMask m = pieceRowAt(piece, i, topLeft.x);
+            if (m == 0)
+                continue;
+            filled[topLeft.y + i] &= ~m;
+        }
+    }
+
+    // returns the rows the piece landed on
+    RowSet place(const PieceMask &piece, ivec2 topLeft, uint32_t color)
+    {
+        RowSet rows = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            RowMask m = pieceRowAt(piece, i, topLeft.x);
+            if (m == 0)
+                continue;
+            int y = topLeft.y + i;
+            placed[y] |= m;
+            filled[y] |= m;
+            paintRow(y, m, color);
+            setColumnBits(y, m);
+            rows |= 1u << y;
+        }
+        dirtyRows |= rows;
+        return rows;
+    }
+
+    RowSet takeDirtyRows()
+    {
+        RowSet rows = dirtyRows;
+        dirtyRows = 0;
+        return rows;
+    }
+
+    bool isPlaced(int x, int y) const
+    {
+        return (placed[y] >> x) & 1;
+    }
+
+    bool isFilled(int x, int y) const
+    {
+        return (filled[y] >> x) & 1;
+    }
+
+    // empty cells straight below (x, y) before a placed cell or the floor
+    int freeBelow(int x, int y) const
+    {
+        RowSet below = (columns[x] | (1u << ARENA_SIZE_Y)) >> (y + 1);
+        return countr_zero(below);
+    }
+
+    bool isLineFull(int y) const
+    {
+        return filled[y] == ROW_FULL;
+    }
+
+    bool isRowEmpty(int y) const
+    {
+        return filled[y] == 0;
+    }
+
+    void copyRow(int from, int to)
+    {
+        dirtyRows |= 1u << to;
+        placed[to] = placed[from];
+        filled[to] = filled[from];
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            colors[to][x] = colors[from][x];
+        }
+    }
+
+    void clearRow(int y)
+    {
+        dirtyRows |= 1u << y;
+        placed[y] = 0;
+        filled[y] = 0;
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            colors[y][x] = 0;
+        }
+    }
+
+    // Removes the given rows and lets everything above fall into place.
+    // One bottom up pass with a single write cursor, so every surviving row
+    // above the lowest cleared line is copied exactly once.
+    void clearLines(RowSet lines)
+    {
+        if (lines == 0)
+            return;
+
+        int write = bit_width(lines) - 1;
+        for (int read = write - 1; read >= 0; --read)
+        {
+            if ((lines >> read) & 1)
+                continue;
+            copyRow(read, write);
+            write--;
+        }
+        for (; write >= 0; --write)
+        {
+            clearRow(write);
+        }
+
+        // same compaction on every column, top line first so the lower ones keep their bit
+        for (RowSet rest = lines; rest != 0; rest &= rest - 1)
+        {
+            int y = countr_zero(rest);
+            RowSet above = (1u << y) - 1;
+            for (int x = 0; x < ARENA_SIZE_X; ++x)
+            {
+                columns[x] = ((columns[x] & above) << 1) | (columns[x] & ~((2u << y) - 1));
+            }
+        }
+    }
+
+private:
+    void setColumnBits(int y, RowMask m)
+    {
+        for (; m != 0; m &= m - 1)
+        {
+            columns[countr_zero(m)] |= 1u << y;
+        }
+    }
+
+    void paintRow(int y, RowMask m, uint32_t color)
+    {
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            if ((m >> x) & 1)
+                colors[y][x] = color;
+        }
+    }
+};
@@ -0,0 +1,274 @@
+#pragma once
+#include <stdint.h>
+
+#include "bitboard.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BOARD_FEATURES_SIMD "avx2"
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BOARD_FEATURES_SIMD "sse2"
+#else
+#define BOARD_FEATURES_SIMD "scalar"
+#endif
+
+using namespace std;
+
+// boards per batch, one 16 bit lane each so a whole batch row fits an AVX2 register
+#define BOARD_BATCH 16
+
+// structure of arrays, rows[y][b] is row y of board b
+struct BoardBatch
+{
+    alignas(32) uint16_t rows[ARENA_SIZE_Y][BOARD_BATCH];
+};
+
+// Feature definitions, shared by every kernel:
+//   heights[x]      rows from the highest cell of column x to the floor, 0 when empty
+//   aggregateHeight sum of heights
+//   holes           empty cells with a filled cell somewhere above them
+//   bumpiness       sum of |heights[x] - heights[x + 1]|
+//   rowTransitions  filled/empty changes walking each row left to right, walls count as filled
+//   wellDepth       well sums, an open cell with filled (or wall) neighbours on both sides
+//                   adds its depth in the well, so a well of depth 3 adds 1 + 2 + 3
+struct BatchFeatures
+{
+    alignas(32) uint16_t heights[ARENA_SIZE_X][BOARD_BATCH];
+    alignas(32) uint16_t aggregateHeight[BOARD_BATCH];
+    alignas(32) uint16_t holes[BOARD_BATCH];
+    alignas(32) uint16_t bumpiness[BOARD_BATCH];
+    alignas(32) uint16_t rowTransitions[BOARD_BATCH];
+    alignas(32) uint16_t wellDepth[BOARD_BATCH];
+};
+
+// row with the two walls as filled cells, bit 0 is the left wall and bit x + 1 column x
+#define ROW_WITH_WALLS(row) ((uint32_t)((row) << 1) | 1u | (1u << (ARENA_SIZE_X + 1)))
+
+// the features of one board
+struct BoardFeatures
+{
+    uint16_t heights[ARENA_SIZE_X];
+    uint16_t aggregateHeight;
+    uint16_t holes;
+    uint16_t bumpiness;
+    uint16_t rowTransitions;
+    uint16_t wellDepth;
+};
+
+// rows[y * stride] is row y, so this reads a plain board or one lane of a batch
+inline BoardFeatures boardFeatures(const uint16_t *rows, int stride)
+{
+    int heights[ARENA_SIZE_X] = {};
+    int wells[ARENA_SIZE_X] = {};
+    int aggregateHeight = 0;
+    int holes = 0;
+    int bumpiness = 0;
+    int rowTransitions = 0;
+    int wellDepth = 0;
+
+    // empty rows above the stack only add the two wall transitions
+    int top = 0;
+    while (top < ARENA_SIZE_Y && rows[top * stride] == 0)
+    {
+        top++;
+    }
+    rowTransitions = 2 * top;
+
+    RowMask seen = 0;
+    for (int y = top; y < ARENA_SIZE_Y; ++y)
+    {
+        RowMask row = rows[y * stride];
+        uint32_t walled = ROW_WITH_WALLS(row);
+        RowMask well = (RowMask)(~(seen | row) & walled & (walled >> 2) & ROW_FULL);
+
+        seen |= row;
+        aggregateHeight += rowPopcount(seen);
+        holes += rowPopcount(seen & ~row);
+        bumpiness += rowPopcount((seen ^ (seen >> 1)) & (ROW_FULL >> 1));
+        uint32_t transitions = (walled ^ (walled >> 1)) & ((1u << (ARENA_SIZE_X + 1)) - 1);
+        rowTransitions += rowPopcount(transitions & ROW_FULL) + (int)(transitions >> ARENA_SIZE_X);
+
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            heights[x] += (seen >> x) & 1;
+            wells[x] = (well >> x) & 1 ? wells[x] + 1 : 0;
+            wellDepth += wells[x];
+        }
+    }
+
+    BoardFeatures f;
+    for (int x = 0; x < ARENA_SIZE_X; ++x)
+    {
+        f.heights[x] = (uint16_t)heights[x];
+    }
+    f.aggregateHeight = (uint16_t)aggregateHeight;
+    f.holes = (uint16_t)holes;
+    f.bumpiness = (uint16_t)bumpiness;
+    f.rowTransitions = (uint16_t)rowTransitions;
+    f.wellDepth = (uint16_t)wellDepth;
+    return f;
+}
+
+inline void computeFeaturesScalar(const BoardBatch &batch, BatchFeatures &out)
+{
+    for (int b = 0; b < BOARD_BATCH; ++b)
+    {
+        BoardFeatures f = boardFeatures(&batch.rows[0][b], BOARD_BATCH);
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            out.heights[x][b] = f.heights[x];
+        }
+        out.aggregateHeight[b] = f.aggregateHeight;
+        out.holes[b] = f.holes;
+        out.bumpiness[b] = f.bumpiness;
+        out.rowTransitions[b] = f.rowTransitions;
+        out.wellDepth[b] = f.wellDepth;
+    }
+}
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+
+// the few 16 bit lane operations the kernel needs, once per register width
+struct Sse2Lanes
+{
+    typedef __m128i V;
+    static const int LANES = 8;
+
+    static V load(const uint16_t *p) { return _mm_load_si128((const __m128i *)p); }
+    static void store(uint16_t *p, V v) { _mm_store_si128((__m128i *)p, v); }
+    static V set1(int v) { return _mm_set1_epi16((short)v); }
+    static V zero() { return _mm_setzero_si128(); }
+    static V add(V a, V b) { return _mm_add_epi16(a, b); }
+    static V sub(V a, V b) { return _mm_sub_epi16(a, b); }
+    static V andv(V a, V b) { return _mm_and_si128(a, b); }
+    static V andnot(V a, V b) { return _mm_andnot_si128(a, b); } // ~a & b
+    static V orv(V a, V b) { return _mm_or_si128(a, b); }
+    static V xorv(V a, V b) { return _mm_xor_si128(a, b); }
+    static V shr(V a, int n) { return _mm_srl_epi16(a, _mm_cvtsi32_si128(n)); }
+    static V shl(V a, int n) { return _mm_sll_epi16(a, _mm_cvtsi32_si128(n)); }
+    static bool isZero(V a) { return _mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128())) == 0xffff; }
+};
+
+#if defined(__AVX2__)
+struct Avx2Lanes
+{
+    typedef __m256i V;
+    static const int LANES = 16;
+
+    static V load(const uint16_t *p) { return _mm256_load_si256((const __m256i *)p); }
+    static void store(uint16_t *p, V v) { _mm256_store_si256((__m256i *)p, v); }
+    static V set1(int v) { return _mm256_set1_epi16((short)v); }
+    static V zero() { return _mm256_setzero_si256(); }
+    static V add(V a, V b) { return _mm256_add_epi16(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_epi16(a, b); }
+    static V andv(V a, V b) { return _mm256_and_si256(a, b); }
+    static V andnot(V a, V b) { return _mm256_andnot_si256(a, b); }
+    static V orv(V a, V b) { return _mm256_or_si256(a, b); }
+    static V xorv(V a, V b) { return _mm256_xor_si256(a, b); }
+    static V shr(V a, int n) { return _mm256_srl_epi16(a, _mm_cvtsi32_si128(n)); }
+    static V shl(V a, int n) { return _mm256_sll_epi16(a, _mm_cvtsi32_si128(n)); }
+    static bool isZero(V a) { return _mm256_testz_si256(a, a); }
+};
+#endif
+
+// SWAR popcount of every 16 bit lane
+template <typename L>
+inline typename L::V popcountLanes(typename L::V v)
+{
+    v = L::sub(v, L::andv(L::shr(v, 1), L::set1(0x5555)));
+    v = L::add(L::andv(v, L::set1(0x3333)), L::andv(L::shr(v, 2), L::set1(0x3333)));
+    v = L::andv(L::add(v, L::shr(v, 4)), L::set1(0x0f0f));
+    return L::andv(L::add(v, L::shr(v, 8)), L::set1(0x1f));
+}
+
+// same definitions as computeFeaturesScalar, one board per lane
+template <typename L>
+inline void computeFeaturesLanes(const BoardBatch &batch, BatchFeatures &out)
+{
+    typedef typename L::V V;
+    const V rowFull = L::set1(ROW_FULL);
+    const V walls = L::set1(1 | (1 << (ARENA_SIZE_X + 1)));
+    const V transitionMask = L::set1((1 << (ARENA_SIZE_X + 1)) - 1);
+    const V bumpMask = L::set1(ROW_FULL >> 1);
+    const V one = L::set1(1);
+
+    for (int lane = 0; lane < BOARD_BATCH; lane += L::LANES)
+    {
+        V heights[ARENA_SIZE_X];
+        V wells[ARENA_SIZE_X];
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            heights[x] = L::zero();
+            wells[x] = L::zero();
+        }
+        // rows empty in every lane only add the two wall transitions
+        int top = 0;
+        while (top < ARENA_SIZE_Y && L::isZero(L::load(&batch.rows[top][lane])))
+        {
+            top++;
+        }
+
+        V aggregateHeight = L::zero();
+        V holes = L::zero();
+        V bumpiness = L::zero();
+        V rowTransitions = L::set1(2 * top);
+        V wellDepth = L::zero();
+        V seen = L::zero();
+
+        for (int y = top; y < ARENA_SIZE_Y; ++y)
+        {
+            V row = L::load(&batch.rows[y][lane]);
+            V walled = L::orv(L::shl(row, 1), walls);
+            V well = L::andv(L::andnot(L::orv(seen, row), walled), L::andv(L::shr(walled, 2), rowFull));
+
+            seen = L::orv(seen, row);
+            aggregateHeight = L::add(aggregateHeight, popcountLanes<L>(seen));
+            holes = L::add(holes, popcountLanes<L>(L::andnot(row, seen)));
+            bumpiness = L::add(bumpiness, popcountLanes<L>(L::andv(L::xorv(seen, L::shr(seen, 1)), bumpMask)));
+            rowTransitions = L::add(rowTransitions,
+                                    popcountLanes<L>(L::andv(L::xorv(walled, L::shr(walled, 1)), transitionMask)));
+
+            for (int x = 0; x < ARENA_SIZE_X; ++x)
+            {
+                heights[x] = L::add(heights[x], L::andv(L::shr(seen, x), one));
+                // 0xffff where column x is a well cell on this row, 0 otherwise
+                V isWell = L::sub(L::zero(), L::andv(L::shr(well, x), one));
+                wells[x] = L::andv(L::add(wells[x], one), isWell);
+                wellDepth = L::add(wellDepth, wells[x]);
+            }
+        }
+
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            L::store(&out.heights[x][lane], heights[x]);
+        }
+        L::store(&out.aggregateHeight[lane], aggregateHeight);
+        L::store(&out.holes[lane], holes);
+        L::store(&out.bumpiness[lane], bumpiness);
+        L::store(&out.rowTransitions[lane], rowTransitions);
+        L::store(&out.wellDepth[lane], wellDepth);
+    }
+}
+
+#endif
+
+// widest kernel the build targets, configure with -DTETRIS_AVX2=ON for the 16 lane one
+inline void computeFeatures(const BoardBatch &batch, BatchFeatures &out)
+{
+#if defined(__AVX2__)
+    computeFeaturesLanes<Avx2Lanes>(batch, out);
+#elif defined(__SSE2__) || defined(_M_X64)
+    computeFeaturesLanes<Sse2Lanes>(batch, out);
+#else
+    computeFeaturesScalar(batch, out);
+#endif
+}
+
+inline void computeFeatures(const BoardBatch *batches, BatchFeatures *out, int batchCount)
+{
+    for (int i = 0; i < batchCount; ++i)
+    {
+        computeFeatures(batches[i], out[i]);
+    }
+}
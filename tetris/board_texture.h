@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+
+using namespace std;
+
+// A board as an ARENA_SIZE_X x ARENA_SIZE_Y RGBA8 texture, one texel per
+// placed cell with alpha 0 where the cell is empty. The falling block is
+// not in it, Arena::renderFalling draws that on top. Cells already carry
+// their own RGB8 color, so the texel is the color itself rather than a
+// palette index. update() compares against what was uploaded last time and
+// only sends the rows that changed, so only frames where a block locked or
+// lines cleared upload anything.
+class BoardTexture
+{
+public:
+    unsigned int textureId;
+
+    int rowsUploaded = 0; // by the last update()
+    uint64_t totalRowsUploaded = 0;
+
+    BoardTexture()
+    {
+        memset(uploaded, 0, sizeof(uploaded));
+        glGenTextures(1, &textureId);
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        // a cell's color must not bleed into its neighbours
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, ARENA_SIZE_X, ARENA_SIZE_Y, 0, GL_RGBA, GL_UNSIGNED_BYTE, uploaded);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    ~BoardTexture()
+    {
+        glDeleteTextures(1, &textureId);
+    }
+
+    BoardTexture(const BoardTexture &) = delete;
+    BoardTexture &operator=(const BoardTexture &) = delete;
+
+    // placed cells, like Arena::renderCells draws them
+    void update(const BitBoard &board)
+    {
+        rowsUploaded = 0;
+        int runStart = -1;
+        for (int y = 0; y <= ARENA_SIZE_Y; ++y)
+        {
+            bool changed = y < ARENA_SIZE_Y && packRow(board, y);
+            if (changed && runStart < 0)
+            {
+                runStart = y;
+            }
+            else if (!changed && runStart >= 0)
+            {
+                // neighbouring changed rows go up together
+                if (rowsUploaded == 0)
+                    glBindTexture(GL_TEXTURE_2D, textureId);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, runStart, ARENA_SIZE_X, y - runStart, GL_RGBA, GL_UNSIGNED_BYTE,
+                                uploaded[runStart]);
+                rowsUploaded += y - runStart;
+                runStart = -1;
+            }
+        }
+        totalRowsUploaded += rowsUploaded;
+    }
+
+private:
+    uint32_t uploaded[ARENA_SIZE_Y][ARENA_SIZE_X];
+
+    // true when row y differs from what the texture holds, which is then updated
+    bool packRow(const BitBoard &board, int y)
+    {
+        uint32_t row[ARENA_SIZE_X];
+        RowMask placed = board.placed[y];
+        for (int x = 0; x < ARENA_SIZE_X; ++x)
+        {
+            row[x] = ((placed >> x) & 1) ? board.colors[y][x] | 0xFF000000u : 0;
+        }
+        if (memcmp(row, uploaded[y], sizeof(row)) == 0)
+            return false;
+        memcpy(uploaded[y], row, sizeof(row));
+        return true;
+    }
+};
@@ -0,0 +1,670 @@
+#pragma once
+#include <bit>
+#include <chrono>
+#include <limits>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "tetris.h"
+#include "board_features.h"
+#include "transposition_table.h"
+#include "zobrist.h"
+
+using namespace std;
+
+#define BOT_MAX_PIECES (BLOCKS_IN_QUEUE + 1)
+#define BOT_MAX_PATH 256
+
+// the bot only ever needs occupancy, never colors
+struct BotBoard
+{
+    RowMask rows[ARENA_SIZE_Y];
+};
+
+class BoardEvaluator
+{
+public:
+    // board is the arena after a placement and its line clears,
+    // linesCleared is the total over every placement leading to it
+    virtual float evaluate(const BotBoard &board, int linesCleared) = 0;
+
+    // scores count boards at once, evaluators with a vectorized path override this
+    virtual void evaluateBatch(const BotBoard *boards, const int *linesCleared, int count, float *scores)
+    {
+        for (int b = 0; b < count; ++b)
+        {
+            scores[b] = evaluate(boards[b], linesCleared[b]);
+        }
+    }
+};
+
+// the usual four feature linear evaluation
+class HeuristicEvaluator : public BoardEvaluator
+{
+public:
+    float heightWeight = -0.51f;
+    float linesWeight = 0.76f;
+    float holesWeight = -0.36f;
+    float bumpinessWeight = -0.18f;
+
+    // Everything is summed row by row from the top. A column is "seen" from its
+    // highest cell down, so aggregate height counts seen cells, holes count empty
+    // seen cells and bumpiness counts neighbours where only one side is seen yet.
+    float evaluate(const BotBoard &board, int linesCleared) override
+    {
+        int aggregateHeight = 0;
+        int holes = 0;
+        int bumpiness = 0;
+        RowMask seen = 0;
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            seen |= board.rows[y];
+            if (seen == 0)
+                continue;
+            aggregateHeight += rowPopcount(seen);
+            holes += rowPopcount(seen & ~board.rows[y]);
+            bumpiness += rowPopcount((seen ^ (seen >> 1)) & (ROW_FULL >> 1));
+        }
+
+        return heightWeight * aggregateHeight + linesWeight * linesCleared +
+               holesWeight * holes + bumpinessWeight * bumpiness;
+    }
+};
+
+// linear evaluation over the board_features.h set, scored a batch at a time
+class FeatureEvaluator : public BoardEvaluator
+{
+public:
+    float heightWeight = -0.51f;
+    float linesWeight = 0.76f;
+    float holesWeight = -0.36f;
+    float bumpinessWeight = -0.18f;
+    float rowTransitionsWeight = -0.12f;
+    float wellDepthWeight = -0.08f;
+
+    float evaluate(const BotBoard &board, int linesCleared) override
+    {
+        BoardFeatures f = boardFeatures(board.rows, 1);
+        return score(f.aggregateHeight, f.holes, f.bumpiness, f.rowTransitions, f.wellDepth, linesCleared);
+    }
+
+    void evaluateBatch(const BotBoard *boards, const int *linesCleared, int count, float *scores) override
+    {
+        for (int start = 0; start < count; start += BOARD_BATCH)
+        {
+            int n = std::min(count - start, BOARD_BATCH);
+            for (int y = 0; y < ARENA_SIZE_Y; ++y)
+            {
+                for (int b = 0; b < BOARD_BATCH; ++b)
+                {
+                    batch.rows[y][b] = b < n ? boards[start + b].rows[y] : 0;
+                }
+            }
+            computeFeatures(batch, features);
+            for (int b = 0; b < n; ++b)
+            {
+                scores[start + b] = score(features.aggregateHeight[b], features.holes[b], features.bumpiness[b],
+                                          features.rowTransitions[b], features.wellDepth[b],
+                                          linesCleared[start + b]);
+            }
+        }
+    }
+
+private:
+    BoardBatch batch;
+    BatchFeatures features;
+
+    float score(int aggregateHeight, int holes, int bumpiness, int rowTransitions, int wellDepth, int lines)
+    {
+        return heightWeight * aggregateHeight + linesWeight * lines + holesWeight * holes +
+               bumpinessWeight * bumpiness + rowTransitionsWeight * rowTransitions + wellDepthWeight * wellDepth;
+    }
+};
+
+struct Placement
+{
+    int8_t rotation;
+    int8_t x;
+    int8_t y;
+};
+
+// upper bound on lock positions, every (rotation, column, row)
+#define BOT_MAX_PLACEMENTS (PIECE_MAX_ROTATIONS * 14 * ARENA_SIZE_Y)
+
+struct PlacementList
+{
+    Placement items[BOT_MAX_PLACEMENTS];
+    int count;
+};
+
+enum BotMove
+{
+    BOT_MOVE_LEFT,
+    BOT_MOVE_RIGHT,
+    BOT_MOVE_ROTATE,
+    BOT_MOVE_DOWN,
+};
+
+// every piece that still has to be placed, the current one first
+struct BotPiece
+{
+    int type;
+    int rotation;
+    ivec2 start;
+};
+
+// Bit (x + 4) of fit[r][y] is set when the piece in rotation r fits with the
+// top left of its template at (x, y). Same 4 wall columns as BitBoard::collides,
+// and row ARENA_SIZE_Y is the floor where nothing fits.
+struct PieceFit
+{
+    uint32_t fit[PIECE_MAX_ROTATIONS][ARENA_SIZE_Y + 1];
+
+    // leading rows where every rotation fits exactly as on an empty board
+    int flatRows;
+
+    void compute(const BotBoard &board, int type)
+    {
+        uint32_t free[ARENA_SIZE_Y + 4];
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            free[y] = ((uint32_t)(ROW_FULL & ~board.rows[y])) << 4;
+        }
+        for (int y = ARENA_SIZE_Y; y < ARENA_SIZE_Y + 4; ++y)
+        {
+            free[y] = 0;
+        }
+
+        // above the stack every row is empty and the fit is the same
+        int top = 0;
+        while (top < ARENA_SIZE_Y && board.rows[top] == 0)
+        {
+            top++;
+        }
+
+        flatRows = ARENA_SIZE_Y;
+        for (int r = 0; r < PIECE_ROTATIONS[type]; ++r)
+        {
+            const PieceShape &shape = PIECES[type][r];
+            flatRows = std::min(flatRows, std::max(0, top - shape.maxY));
+            uint32_t emptyFit = ~0u;
+            for (const PieceCell &c : shape.cells)
+            {
+                emptyFit &= ((uint32_t)ROW_FULL << 4) >> c.x;
+            }
+            int y = 0;
+            for (; y + shape.maxY < top; ++y)
+            {
+                fit[r][y] = emptyFit;
+            }
+            for (; y <= ARENA_SIZE_Y; ++y)
+            {
+                uint32_t f = ~0u;
+                for (const PieceCell &c : shape.cells)
+                {
+                    f &= free[y + c.y] >> c.x;
+                }
+                fit[r][y] = f;
+            }
+        }
+    }
+
+    bool fits(int r, int x, int y) const
+    {
+        return x >= -4 && x < 28 && y >= 0 && y < ARENA_SIZE_Y && ((fit[r][y] >> (x + 4)) & 1);
+    }
+};
+
+class Bot
+{
+public:
+    BoardEvaluator *evaluator;
+    int lookahead;   // pieces from the next queue searched after the current one
+    double budgetMs; // per think(), the deepest fully searched lookahead wins
+
+    // optional, owned by the caller and kept across think() calls so
+    // subtrees searched for the previous move are not searched again
+    TranspositionTable *table = nullptr;
+
+    // stats of the last think()
+    uint64_t evaluated;
+    int depthReached;
+    bool outOfTime;
+
+    Bot(BoardEvaluator *evaluator, int lookahead = 1, double budgetMs = 4.0)
+        : evaluator(evaluator), lookahead(lookahead), budgetMs(budgetMs)
+    {
+        evaluated = 0;
+        depthReached = -1;
+        outOfTime = false;
+    }
+
+    // Enumerates every lock position reachable from start with the arena rules:
+    // left, right, rotate in place and down, each only into free cells.
+    static void enumeratePlacements(const PieceFit &pf, const BotPiece &piece, PlacementList &out)
+    {
+        out.count = 0;
+        int rotations = PIECE_ROTATIONS[piece.type];
+        if (!pf.fits(piece.rotation, piece.start.x, piece.start.y))
+            return;
+
+        // only the current row is kept, pieces never move up
+        uint32_t reach[PIECE_MAX_ROTATIONS] = {};
+        reach[piece.rotation] = 1u << (piece.start.x + 4);
+
+        for (int y = piece.start.y; y < ARENA_SIZE_Y; ++y)
+        {
+            // spread sideways and through rotations until nothing new shows up
+            bool changed = true;
+            while (changed)
+            {
+                changed = false;
+                for (int r = 0; r < rotations; ++r)
+                {
+                    uint32_t cur = reach[r];
+                    if (cur == 0)
+                        continue;
+                    uint32_t fit = pf.fit[r][y];
+                    while (true)
+                    {
+                        uint32_t spread = cur | (((cur << 1) | (cur >> 1)) & fit);
+                        if (spread == cur)
+                            break;
+                        cur = spread;
+                    }
+                    reach[r] = cur;
+
+                    int rn = (r + 1) % rotations;
+                    uint32_t rotated = cur & pf.fit[rn][y] & ~reach[rn];
+                    if (rotated != 0)
+                    {
+                        reach[rn] |= rotated;
+                        changed = true;
+                    }
+                }
+            }
+
+            // rows above the stack all look alike, nothing can lock there
+            // and every row down to the stack reaches the same positions
+            if (y + 1 < pf.flatRows)
+            {
+                y = pf.flatRows - 2;
+                continue;
+            }
+
+            bool any = false;
+            for (int r = 0; r < rotations; ++r)
+            {
+                uint32_t land = reach[r] & ~pf.fit[r][y + 1];
+                while (land != 0)
+                {
+                    int bit = countr_zero(land);
+                    out.items[out.count++] = Placement{(int8_t)r, (int8_t)(bit - 4), (int8_t)y};
+                    land &= land - 1;
+                }
+                reach[r] &= pf.fit[r][y + 1];
+                any |= reach[r] != 0;
+            }
+            if (!any)
+                break;
+        }
+    }
+
+    // returns the lines cleared, or -1 when the piece locks inside the hidden rows
+    static int applyPlacement(BotBoard &board, int type, const Placement &p)
+    {
+        const PieceMask &mask = PIECES[type][p.rotation].mask;
+        RowSet full = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (mask.rows[i] == 0)
+                continue;
+            int y = p.y + i;
+            if (y < ARENA_HIDDEN_HEIGHT)
+                return -1;
+            board.rows[y] |= BitBoard::pieceRowAt(mask, i, p.x);
+            if (board.rows[y] == ROW_FULL)
+                full |= 1u << y;
+        }
+        if (full == 0)
+            return 0;
+
+        int write = bit_width(full) - 1;
+        for (int read = write - 1; read >= 0; --read)
+        {
+            if ((full >> read) & 1)
+                continue;
+            board.rows[write--] = board.rows[read];
+        }
+        for (; write >= 0; --write)
+        {
+            board.rows[write] = 0;
+        }
+        return popcount(full);
+    }
+
+    // picks the best lock position for the arena's falling block,
+    // false when there is no falling block or nowhere to put it
+    bool think(const Arena &arena, Placement &best)
+    {
+        evaluated = 0;
+        depthReached = -1;
+        outOfTime = false;
+        if (!arena.selected)
+            return false;
+
+        BotBoard board;
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            board.rows[y] = arena.board.placed[y];
+        }
+
+        pieceCount = 1;
+        pieces[0] = BotPiece{arena.selected->type, arena.selected->rotation, arena.selectedIndex};
+        for (int i = 0; i < arena.next.size() && i < lookahead && pieceCount < BOT_MAX_PIECES; ++i)
+        {
+            const Block &b = arena.next[i];
+            pieces[pieceCount++] = BotPiece{b.type, b.rotation, ivec2(b.shape().spawnX, b.shape().spawnY)};
+        }
+
+        if (table != nullptr)
+            table->newSearch();
+        uint64_t hash = table != nullptr ? zobristRows(board.rows, 0, ARENA_SIZE_Y) : 0;
+
+        deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(
+                                                      chrono::duration<double, milli>(budgetMs));
+        bool found = false;
+        for (int depth = 0; depth < pieceCount; ++depth)
+        {
+            Placement candidate;
+            float score;
+            if (!searchRoot(board, hash, depth, candidate, score))
+                break;
+            if (score == -numeric_limits<float>::infinity() && found)
+                break;
+            best = candidate;
+            found = true;
+            depthReached = depth;
+        }
+        return found;
+    }
+
+    // Breadth first search from the falling block to p, moves come out in the
+    // order they have to be applied. Returns the number of moves, -1 if unreachable.
+    static int findPath(const Arena &arena, const Placement &p, BotMove *moves, int maxMoves)
+    {
+        if (!arena.selected)
+            return -1;
+        BotBoard board;
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            board.rows[y] = arena.board.placed[y];
+        }
+        int type = arena.selected->type;
+        int rotations = PIECE_ROTATIONS[type];
+        PieceFit pf;
+        pf.compute(board, type);
+
+        // state = (rotation, x + 4, y)
+        const int stateCount = PIECE_MAX_ROTATIONS * 32 * ARENA_SIZE_Y;
+        int16_t parent[stateCount];
+        uint8_t via[stateCount];
+        int16_t queue[stateCount];
+        for (int i = 0; i < stateCount; ++i)
+        {
+            parent[i] = -2;
+        }
+        auto stateOf = [](int r, int x, int y) { return (r * ARENA_SIZE_Y + y) * 32 + x + 4; };
+
+        int start = stateOf(arena.selected->rotation, arena.selectedIndex.x, arena.selectedIndex.y);
+        int goal = stateOf(p.rotation, p.x, p.y);
+        int head = 0, tail = 0;
+        parent[start] = -1;
+        queue[tail++] = start;
+        while (head < tail && parent[goal] == -2)
+        {
+            int s = queue[head++];
+            int x = s % 32 - 4;
+            int y = (s / 32) % ARENA_SIZE_Y;
+            int r = s / 32 / ARENA_SIZE_Y;
+            const int next[4][3] = {{r, x - 1, y}, {r, x + 1, y}, {(r + 1) % rotations, x, y}, {r, x, y + 1}};
+            for (int m = 0; m < 4; ++m)
+            {
+                if (!pf.fits(next[m][0], next[m][1], next[m][2]))
+                    continue;
+                int n = stateOf(next[m][0], next[m][1], next[m][2]);
+                if (parent[n] != -2)
+                    continue;
+                parent[n] = s;
+                via[n] = m;
+                queue[tail++] = n;
+            }
+        }
+        if (parent[goal] == -2)
+            return -1;
+
+        int count = 0;
+        for (int s = goal; parent[s] != -1; s = parent[s])
+        {
+            count++;
+        }
+        if (count > maxMoves)
+            return -1;
+        int i = count;
+        for (int s = goal; parent[s] != -1; s = parent[s])
+        {
+            moves[--i] = (BotMove)via[s];
+        }
+        return count;
+    }
+
+    // spawns if needed, thinks, walks the block to the chosen spot and locks it,
+    // false when there was no placement or no path to it and the block only fell a row
+    bool play(Arena &arena)
+    {
+        if (!arena.selected)
+            arena.moveDown();
+        if (!arena.selected)
+            return true;
+
+        Placement best;
+        if (!think(arena, best))
+        {
+            arena.moveDown();
+            return false;
+        }
+        BotMove moves[BOT_MAX_PATH];
+        int count = findPath(arena, best, moves, BOT_MAX_PATH);
+        if (count < 0)
+        {
+            arena.moveDown();
+            return false;
+        }
+        // the straight fall at the end is one hard drop
+        while (count > 0 && moves[count - 1] == BOT_MOVE_DOWN)
+        {
+            count--;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            switch (moves[i])
+            {
+            case BOT_MOVE_LEFT:
+                arena.moveHorizontal(true, false);
+                break;
+            case BOT_MOVE_RIGHT:
+                arena.moveHorizontal(false, true);
+                break;
+            case BOT_MOVE_ROTATE:
+                arena.rotate();
+                break;
+            case BOT_MOVE_DOWN:
+                arena.moveDown();
+                break;
+            }
+        }
+        arena.hardDrop();
+        return true;
+    }
+
+private:
+    BotPiece pieces[BOT_MAX_PIECES];
+    int pieceCount;
+    chrono::steady_clock::time_point deadline;
+
+    bool timeLeft(int count)
+    {
+        // the clock is only read once every 1024 evaluations
+        uint64_t before = evaluated;
+        evaluated += count;
+        if ((before >> 10) != (evaluated >> 10) && chrono::steady_clock::now() > deadline)
+            outOfTime = true;
+        return !outOfTime;
+    }
+
+    // Scores every placement of piece on board, children go to the evaluator
+    // BOARD_BATCH at a time. Placements locking in the hidden rows score -inf.
+    void evaluatePlacements(const BotBoard &board, int type, const PlacementList &list, int lines, float *scores)
+    {
+        BotBoard children[BOARD_BATCH];
+        int childLines[BOARD_BATCH];
+        int childIndex[BOARD_BATCH];
+        float childScores[BOARD_BATCH];
+        int n = 0;
+        for (int i = 0; i < list.count; ++i)
+        {
+            children[n] = board;
+            int cleared = applyPlacement(children[n], type, list.items[i]);
+            scores[i] = -numeric_limits<float>::infinity();
+            if (cleared >= 0)
+            {
+                childLines[n] = lines + cleared;
+                childIndex[n] = i;
+                n++;
+            }
+            if (n == BOARD_BATCH || (i + 1 == list.count && n > 0))
+            {
+                evaluator->evaluateBatch(children, childLines, n, childScores);
+                for (int b = 0; b < n; ++b)
+                {
+                    scores[childIndex[b]] = childScores[b];
+                }
+                timeLeft(n);
+                n = 0;
+            }
+        }
+    }
+
+    // Key of the position before pieces[pieceIndex] is placed. Only what the
+    // subtree depends on goes in: the board, the pieces still to place and the
+    // lines cleared so far, never the absolute piece index, so the next move
+    // finds what this one stored.
+    uint64_t nodeKey(uint64_t boardHash, int pieceIndex, int depth, int lines) const
+    {
+        uint64_t key = boardHash ^ ZOBRIST.lines[std::min(lines, ZOBRIST_MAX_LINES)];
+        for (int i = pieceIndex; i <= depth; ++i)
+        {
+            key ^= ZOBRIST.sequence[i - pieceIndex][pieces[i].type][pieces[i].rotation];
+        }
+        return key;
+    }
+
+    uint64_t childHash(uint64_t boardHash, const BotBoard &child, int type, const Placement &p, int cleared) const
+    {
+        if (table == nullptr)
+            return 0;
+        if (cleared > 0)
+            return zobristRows(child.rows, 0, ARENA_SIZE_Y);
+        return boardHash ^ zobristPieceCells(type, p.rotation, ivec2(p.x, p.y));
+    }
+
+    bool searchRoot(const BotBoard &board, uint64_t hash, int depth, Placement &best, float &bestScore)
+    {
+        PieceFit pf;
+        pf.compute(board, pieces[0].type);
+        PlacementList list;
+        enumeratePlacements(pf, pieces[0], list);
+
+        bestScore = -numeric_limits<float>::infinity();
+        best = Placement{(int8_t)pieces[0].rotation, (int8_t)pieces[0].start.x, (int8_t)pieces[0].start.y};
+        float leafScores[BOT_MAX_PLACEMENTS];
+        if (depth == 0)
+        {
+            evaluatePlacements(board, pieces[0].type, list, 0, leafScores);
+            if (outOfTime)
+                return false;
+        }
+        for (int i = 0; i < list.count; ++i)
+        {
+            float score;
+            if (depth == 0)
+            {
+                score = leafScores[i];
+            }
+            else
+            {
+                BotBoard child = board;
+                int lines = applyPlacement(child, pieces[0].type, list.items[i]);
+                if (lines < 0)
+                    score = -numeric_limits<float>::infinity();
+                else
+                    score = search(child, childHash(hash, child, pieces[0].type, list.items[i], lines), 1, depth, lines);
+            }
+            if (outOfTime)
+                return false;
+            if (score > bestScore || i == 0)
+            {
+                bestScore = score;
+                best = list.items[i];
+            }
+        }
+        return list.count > 0;
+    }
+
+    float search(const BotBoard &board, uint64_t hash, int pieceIndex, int depth, int lines)
+    {
+        uint64_t key = 0;
+        float cached;
+        if (table != nullptr)
+        {
+            key = nodeKey(hash, pieceIndex, depth, lines);
+            if (table->probe(key, cached))
+                return cached;
+        }
+
+        const BotPiece &piece = pieces[pieceIndex];
+        PieceFit pf;
+        pf.compute(board, piece.type);
+        PlacementList list;
+        enumeratePlacements(pf, piece, list);
+
+        float bestScore = -numeric_limits<float>::infinity();
+        if (pieceIndex == depth)
+        {
+            // last piece, its children are the leaves
+            float scores[BOT_MAX_PLACEMENTS];
+            evaluatePlacements(board, piece.type, list, lines, scores);
+            for (int i = 0; i < list.count; ++i)
+            {
+                bestScore = std::max(bestScore, scores[i]);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < list.count && !outOfTime; ++i)
+            {
+                BotBoard child = board;
+                int cleared = applyPlacement(child, piece.type, list.items[i]);
+                if (cleared < 0)
+                    continue;
+                uint64_t h = childHash(hash, child, piece.type, list.items[i], cleared);
+                bestScore = std::max(bestScore, search(child, h, pieceIndex + 1, depth, lines + cleared));
+            }
+        }
+
+        // a search cut short by the deadline is not the real score
+        if (table != nullptr && !outOfTime)
+            table->store(key, bestScore, depth - pieceIndex + 1);
+        return bestScore;
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <stdint.h>
+
+using namespace std;
+
+// ticks one advance() may run to catch up, anything more behind is dropped
+#define FIXED_TIMESTEP_MAX_CATCH_UP 8
+// ticks per advance() when fast forwarding
+#define FIXED_TIMESTEP_FAST_FORWARD_BATCH 64
+
+// Turns wall clock time into whole simulation ticks. Elapsed time goes into
+// an accumulator and advance() hands out every full tick in it, the rest
+// stays for next time and alpha() says how far into the next tick that is,
+// for drawing between two ticks. After a long stall only maxCatchUp ticks
+// run and the rest of the backlog is dropped, so a slow machine falls
+// behind the clock instead of spending ever longer catching up with it.
+class FixedTimestep
+{
+public:
+    double tickSeconds;
+    int maxCatchUp;
+    // run ticks back to back whatever the clock says, for replays and headless runs
+    bool fastForward;
+
+    uint64_t ticks = 0;
+    uint64_t droppedTicks = 0;
+
+    FixedTimestep(double tickSeconds, int maxCatchUp = FIXED_TIMESTEP_MAX_CATCH_UP, bool fastForward = false)
+        : tickSeconds(tickSeconds), maxCatchUp(maxCatchUp), fastForward(fastForward)
+    {
+    }
+
+    // ticks to run now that elapsedSeconds more went by
+    int advance(double elapsedSeconds)
+    {
+        if (fastForward)
+        {
+            ticks += FIXED_TIMESTEP_FAST_FORWARD_BATCH;
+            return FIXED_TIMESTEP_FAST_FORWARD_BATCH;
+        }
+        accumulator += elapsedSeconds;
+        int64_t due = (int64_t)(accumulator / tickSeconds);
+        accumulator -= due * tickSeconds;
+        if (due > maxCatchUp)
+        {
+            droppedTicks += due - maxCatchUp;
+            due = maxCatchUp;
+        }
+        ticks += due;
+        return (int)due;
+    }
+
+    // 0 right on the last tick, 1 when the next one is due
+    double alpha() const
+    {
+        return fastForward ? 1.0 : std::min(accumulator / tickSeconds, 1.0);
+    }
+
+    double secondsUntilNextTick() const
+    {
+        return fastForward ? 0.0 : std::max(tickSeconds - accumulator, 0.0);
+    }
+
+private:
+    double accumulator = 0.0;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace std;
+
+// bytes the frame allocator starts with, a frame of this game uses a few KB
+#define FRAME_ALLOCATOR_BYTES (64 * 1024)
+
+// Bump allocator for render data that only lives until the frame is
+// presented, sprite lists put together for one draw or text laid out
+// every frame. allocate() moves a pointer along one block and reset() at
+// the end of the frame moves it back, nothing is freed one by one. A frame
+// that does not fit spills onto the heap and the next reset() swaps in a
+// block big enough for it, so after the first few frames nothing here
+// touches the heap again.
+class FrameAllocator
+{
+public:
+    size_t used = 0;
+    size_t highWater = 0; // most bytes any frame needed so far
+    uint64_t spills = 0;  // allocations that did not fit the block
+
+    FrameAllocator(size_t capacity = FRAME_ALLOCATOR_BYTES) : capacity(capacity), block(new byte[capacity])
+    {
+    }
+
+    FrameAllocator(const FrameAllocator &) = delete;
+    FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+    // count value initialized Ts, valid until the next reset()
+    template <typename T> span<T> allocate(size_t count)
+    {
+        static_assert(is_trivially_destructible_v<T>, "reset() runs no destructors");
+        size_t start = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+        size_t bytes = count * sizeof(T);
+        used = start + bytes;
+        void *p;
+        if (used <= capacity)
+        {
+            p = block.get() + start;
+        }
+        else
+        {
+            spills++;
+            spilled.push_back(make_unique<byte[]>(bytes + alignof(T)));
+            p = spilled.back().get();
+            size_t space = bytes + alignof(T);
+            p = align(alignof(T), bytes, p, space);
+        }
+        T *first = (T *)p;
+        uninitialized_value_construct_n(first, count);
+        return span<T>(first, count);
+    }
+
+    // the frame is done with everything it allocated
+    void reset()
+    {
+        highWater = std::max(highWater, used);
+        if (highWater > capacity)
+        {
+            capacity = highWater * 2;
+            block.reset(new byte[capacity]);
+        }
+        spilled.clear();
+        used = 0;
+    }
+
+    size_t size() const
+    {
+        return capacity;
+    }
+
+private:
+    size_t capacity;
+    unique_ptr<byte[]> block;
+    vector<unique_ptr<byte[]>> spilled;
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // std::min and std::max in the headers after this one
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// the most the capped wait spins before a deadline, sleeps are trusted up to there
+#define FRAME_PACER_SPIN 0.002
+// frames drawn per second while paused or in the background
+#define FRAME_PACER_IDLE_FPS 10
+
+enum PacingMode
+{
+    // the swap waits for the display, glfwSwapInterval(1)
+    PACING_VSYNC,
+    // FramePacer::wait holds every frame to 1 / fps
+    PACING_CAPPED,
+    // as fast as the loop goes, for measuring
+    PACING_UNCAPPED,
+};
+
+// seconds of cpu time used by every thread of the process so far
+inline double processCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    auto seconds = [](FILETIME t) { return (((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) * 1e-7; };
+    return seconds(kernel) + seconds(user);
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+// Holds frames to a steady interval for PACING_CAPPED. Each deadline is the
+// last one plus the interval rather than now plus the interval, so a frame
+// that runs late does not push every later frame back. wait() sleeps until
+// a margin before the deadline and yields in a loop for the rest, which
+// keeps the cpu mostly idle without inheriting the sleep's wake up error.
+// The margin follows how late sleeps have been waking on this machine,
+// tens of microseconds on linux, up to a timer tick elsewhere.
+class FramePacer
+{
+public:
+    PacingMode mode;
+    double interval;       // seconds per frame when capped
+    double maxSpinSeconds; // 0 only sleeps
+    double spinSeconds;    // the margin now
+
+    FramePacer(PacingMode mode, double fps, double maxSpinSeconds = FRAME_PACER_SPIN)
+        : mode(mode), interval(1.0 / fps), maxSpinSeconds(maxSpinSeconds), spinSeconds(maxSpinSeconds),
+          deadline(now())
+    {
+    }
+
+    // monotonic, in seconds
+    static double now()
+    {
+        return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // call after presenting a frame, returns once the next one may start
+    void wait()
+    {
+        if (mode != PACING_CAPPED)
+            return;
+        deadline += interval;
+        double t = now();
+        // more than a frame behind, start counting from here
+        if (t > deadline + interval)
+        {
+            deadline = t;
+            return;
+        }
+        double sleepFor = deadline - spinSeconds - t;
+        if (sleepFor > 0.0)
+        {
+            this_thread::sleep_for(chrono::duration<double>(sleepFor));
+            // a later wake up widens the margin at once, earlier ones narrow it slowly
+            double late = now() - t - sleepFor;
+            spinSeconds = late > spinSeconds ? late : spinSeconds * 0.95 + late * 0.05;
+            spinSeconds = std::min(std::max(spinSeconds, 0.0), maxSpinSeconds);
+        }
+        while (now() < deadline)
+        {
+            this_thread::yield();
+        }
+    }
+
+    // a frame that was not waited for, like an idle one, starts the count again
+    void restart()
+    {
+        deadline = now();
+    }
+
+private:
+    double deadline;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <stddef.h>
+
+using namespace std;
+
+struct FrameTimeSummary
+{
+    int count;
+    double meanMs;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+};
+
+// Durations measured by one thread, a frame or a tick each. take() sums up
+// the ones added since the last take() and starts over. Samples past the
+// capacity are not kept, so add() never allocates.
+class FrameTimeStats
+{
+public:
+    FrameTimeStats(size_t capacity = 4096)
+    {
+        samples.reserve(capacity);
+    }
+
+    void add(double ms)
+    {
+        if (samples.size() < samples.capacity())
+            samples.push_back(ms);
+    }
+
+    FrameTimeSummary take()
+    {
+        FrameTimeSummary s = {(int)samples.size(), 0.0, 0.0, 0.0, 0.0};
+        if (samples.empty())
+            return s;
+        sort(samples.begin(), samples.end());
+        double total = 0.0;
+        for (double ms : samples)
+        {
+            total += ms;
+        }
+        s.meanMs = total / samples.size();
+        s.p50Ms = samples[samples.size() / 2];
+        s.p99Ms = samples[samples.size() * 99 / 100];
+        s.maxMs = samples.back();
+        samples.clear();
+        return s;
+    }
+
+private:
+    vector<double> samples;
+};
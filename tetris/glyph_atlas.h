@@ -0,0 +1,174 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+
+#include "sprite.h"
+
+using namespace std;
+using namespace glm;
+
+#define GLYPH_ATLAS_WIDTH 1024
+#define GLYPH_ATLAS_MIN_HEIGHT 256
+#define GLYPH_ATLAS_MAX_HEIGHT 4096
+#define GLYPH_ATLAS_PADDING 1
+
+// Rows of rectangles ("shelves"), each as tall as the tallest thing put on it.
+// A rectangle goes on the first shelf it fits, else a new shelf opens below.
+// Glyphs of one size are all about as tall, so very little space is wasted.
+class ShelfPacker
+{
+public:
+    struct Shelf
+    {
+        int y;
+        int height;
+        int x; // first free column
+    };
+
+    int width;
+    int height;
+    vector<Shelf> shelves;
+
+    ShelfPacker(int width, int height) : width(width), height(height)
+    {
+    }
+
+    bool pack(int w, int h, ivec2 &topLeft)
+    {
+        if (w > width)
+            return false;
+        for (Shelf &s : shelves)
+        {
+            // a much taller shelf would waste its rest on this one rectangle
+            if (h <= s.height && h * 4 >= s.height * 3 && s.x + w <= width)
+            {
+                topLeft = ivec2(s.x, s.y);
+                s.x += w;
+                return true;
+            }
+        }
+        int y = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+        if (y + h > height)
+            return false;
+        shelves.push_back(Shelf{y, h, w});
+        topLeft = ivec2(0, y);
+        return true;
+    }
+
+    void clear()
+    {
+        shelves.clear();
+    }
+};
+
+// One GL_R8 texture every glyph is packed into, with a cpu copy so growing it
+// never needs to read back from the gpu. It starts small and doubles its
+// height when full. For the software backend the cpu copy is all there is.
+class GlyphAtlas
+{
+public:
+    unsigned int textureId;
+    ShelfPacker packer;
+    vector<uint8_t> pixels;
+    const RenderBackend backend;
+
+    GlyphAtlas(RenderBackend backend = RENDER_GL) : packer(GLYPH_ATLAS_WIDTH, GLYPH_ATLAS_MIN_HEIGHT), backend(backend)
+    {
+        pixels.assign((size_t)packer.width * packer.height, 0);
+        if (backend == RENDER_SOFTWARE)
+        {
+            textureId = nextSoftTextureId();
+            return;
+        }
+        glGenTextures(1, &textureId);
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        uploadAll();
+    }
+
+    ~GlyphAtlas()
+    {
+        if (backend == RENDER_GL)
+            glDeleteTextures(1, &textureId);
+    }
+
+    GlyphAtlas(const GlyphAtlas &) = delete;
+    GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+    // Copies a w x h bitmap (rows pitch bytes apart) into the atlas and returns
+    // its uv rect as (u0, v0, u1, v1). False when even the largest atlas is full.
+    bool add(const uint8_t *bitmap, int w, int h, int pitch, vec4 &uv)
+    {
+        ivec2 topLeft;
+        while (!packer.pack(w + GLYPH_ATLAS_PADDING, h + GLYPH_ATLAS_PADDING, topLeft))
+        {
+            if (packer.height * 2 > GLYPH_ATLAS_MAX_HEIGHT)
+                return false;
+            grow();
+        }
+
+        for (int row = 0; row < h; ++row)
+        {
+            memcpy(&pixels[(size_t)(topLeft.y + row) * packer.width + topLeft.x], bitmap + (size_t)row * pitch, w);
+        }
+        if (backend == RENDER_GL)
+        {
+            glBindTexture(GL_TEXTURE_2D, textureId);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, packer.width);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, topLeft.x, topLeft.y, w, h, GL_RED, GL_UNSIGNED_BYTE,
+                            &pixels[(size_t)topLeft.y * packer.width + topLeft.x]);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        }
+
+        uv = rectUv(topLeft, w, h);
+        return true;
+    }
+
+    int width() const
+    {
+        return packer.width;
+    }
+
+    int height() const
+    {
+        return packer.height;
+    }
+
+    size_t bytes() const
+    {
+        return pixels.size();
+    }
+
+    // relative to the current height, growing the atlas halves every v
+    vec4 rectUv(ivec2 topLeft, int w, int h) const
+    {
+        return vec4((float)topLeft.x / packer.width, (float)topLeft.y / packer.height,
+                    (float)(topLeft.x + w) / packer.width, (float)(topLeft.y + h) / packer.height);
+    }
+
+private:
+    void grow()
+    {
+        packer.height *= 2;
+        pixels.resize((size_t)packer.width * packer.height, 0);
+        uploadAll();
+    }
+
+    void uploadAll()
+    {
+        if (backend == RENDER_SOFTWARE)
+            return;
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, packer.width, packer.height, 0, GL_RED, GL_UNSIGNED_BYTE,
+                     pixels.data());
+    }
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_MODULE_H
+
+using namespace std;
+
+// distance field glyphs are rasterized once at this size and scaled to any other
+#define GLYPH_SDF_SIZE 32
+// pixels the distance field reaches past the outline, on both sides
+#define GLYPH_SDF_SPREAD 4
+
+// rasterized at startup so the first frames do not wait on the glyphs everyone uses
+#define GLYPH_PREWARM_CHARSET " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~"
+
+enum GlyphMode
+{
+    // coverage bitmaps, one set of glyphs per pixel size
+    GLYPH_BITMAP,
+    // signed distance fields, 128 on the outline and higher inside, one set for every size
+    GLYPH_SDF,
+};
+
+// one rasterized glyph : a font, a pixel size and a unicode codepoint
+struct GlyphKey
+{
+    uint32_t font;
+    uint32_t size;
+    uint32_t codepoint;
+
+    bool operator==(const GlyphKey &other) const
+    {
+        return font == other.font && size == other.size && codepoint == other.codepoint;
+    }
+};
+
+namespace std
+{
+template <> struct hash<GlyphKey>
+{
+    size_t operator()(const GlyphKey &k) const
+    {
+        uint64_t h = ((uint64_t)k.font << 48) ^ ((uint64_t)k.size << 32) ^ k.codepoint;
+        return hash<uint64_t>()(h * 0x9E3779B97F4A7C15ull);
+    }
+};
+} // namespace std
+
+// a glyph bitmap waiting in the staging area for the gl thread, rows are width bytes
+struct RasterizedGlyph
+{
+    GlyphKey key;
+    bool ok;
+    int width;
+    int height;
+    int advanceX;
+    int advanceY;
+    int bearingX;
+    int bearingY;
+    vector<uint8_t> pixels;
+};
+
+// Runs FreeType on a worker thread. request() queues a glyph, the worker
+// renders it into the staging area and takeFinished() hands every finished
+// bitmap to the gl thread in one go. Nothing here touches gl.
+class GlyphRasterizer
+{
+public:
+    const GlyphMode mode;
+
+    GlyphRasterizer(GlyphMode mode = GLYPH_BITMAP) : mode(mode), stopping(false), busy(false)
+    {
+        if (FT_Init_FreeType(&library))
+        {
+            throw runtime_error("unable to load FT_Init_FreeType");
+        }
+        if (mode == GLYPH_SDF)
+        {
+            FT_Int spread = GLYPH_SDF_SPREAD;
+            FT_Property_Set(library, "sdf", "spread", &spread);
+        }
+        worker = thread(&GlyphRasterizer::workerLoop, this);
+    }
+
+    ~GlyphRasterizer()
+    {
+        {
+            lock_guard<mutex> lock(queueMtx);
+            stopping = true;
+        }
+        wakeCv.notify_all();
+        worker.join();
+        for (FT_Face face : faces)
+        {
+            FT_Done_Face(face);
+        }
+        FT_Done_FreeType(library);
+    }
+
+    GlyphRasterizer(const GlyphRasterizer &) = delete;
+    GlyphRasterizer &operator=(const GlyphRasterizer &) = delete;
+
+    // opens the face right away so a bad path still throws on the caller's thread
+    uint32_t loadFont(const string &path)
+    {
+        lock_guard<mutex> lock(faceMtx);
+        FT_Face face;
+        if (FT_New_Face(library, path.c_str(), 0, &face))
+        {
+            throw runtime_error("unable to load FT_New_Face");
+        }
+        faces.push_back(face);
+        faceSizes.push_back(0);
+        return (uint32_t)faces.size() - 1;
+    }
+
+    void request(GlyphKey key)
+    {
+        {
+            lock_guard<mutex> lock(queueMtx);
+            requests.push_back(key);
+        }
+        wakeCv.notify_one();
+    }
+
+    // moves every glyph finished so far into out, never waits on the worker
+    void takeFinished(vector<RasterizedGlyph> &out)
+    {
+        lock_guard<mutex> lock(queueMtx);
+        for (RasterizedGlyph &g : finished)
+        {
+            out.push_back(move(g));
+        }
+        finished.clear();
+    }
+
+    // blocks until every request so far is in the staging area
+    void waitIdle()
+    {
+        unique_lock<mutex> lock(queueMtx);
+        idleCv.wait(lock, [this] { return requests.empty() && !busy; });
+    }
+
+    size_t pending()
+    {
+        lock_guard<mutex> lock(queueMtx);
+        return requests.size() + (busy ? 1 : 0);
+    }
+
+private:
+    FT_Library library;
+    vector<FT_Face> faces;
+    vector<int> faceSizes;
+    mutex faceMtx; // faces and library, FreeType is not thread safe per library
+
+    mutex queueMtx;
+    condition_variable wakeCv;
+    condition_variable idleCv;
+    deque<GlyphKey> requests;
+    vector<RasterizedGlyph> finished;
+    bool stopping;
+    bool busy;
+
+    thread worker;
+
+    RasterizedGlyph rasterize(GlyphKey key)
+    {
+        lock_guard<mutex> lock(faceMtx);
+        RasterizedGlyph g = {key, false, 0, 0, 0, 0, 0, 0, {}};
+        FT_Face face = faces[key.font];
+        if (faceSizes[key.font] != (int)key.size)
+        {
+            FT_Set_Pixel_Sizes(face, 0, key.size);
+            faceSizes[key.font] = key.size;
+        }
+        if (mode == GLYPH_BITMAP)
+        {
+            if (FT_Load_Char(face, key.codepoint, FT_LOAD_RENDER))
+                return g;
+        }
+        else
+        {
+            if (FT_Load_Char(face, key.codepoint, FT_LOAD_DEFAULT))
+                return g;
+            // blanks like the space have no outline to measure distances to
+            FT_GlyphSlot slot = face->glyph;
+            bool empty = slot->format == FT_GLYPH_FORMAT_OUTLINE && slot->outline.n_points == 0;
+            if (!empty && FT_Render_Glyph(slot, FT_RENDER_MODE_SDF))
+                return g;
+        }
+
+        FT_Bitmap &bitmap = face->glyph->bitmap;
+        g.ok = true;
+        g.width = (int)bitmap.width;
+        g.height = (int)bitmap.rows;
+        g.advanceX = (int)face->glyph->advance.x;
+        g.advanceY = (int)face->glyph->advance.y;
+        g.bearingX = face->glyph->bitmap_left;
+        g.bearingY = face->glyph->bitmap_top;
+        g.pixels.resize((size_t)g.width * g.height);
+        for (int row = 0; row < g.height; ++row)
+        {
+            memcpy(&g.pixels[(size_t)row * g.width], bitmap.buffer + (ptrdiff_t)row * bitmap.pitch, g.width);
+        }
+        return g;
+    }
+
+    void workerLoop()
+    {
+        unique_lock<mutex> lock(queueMtx);
+        while (true)
+        {
+            wakeCv.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping)
+                return;
+
+            GlyphKey key = requests.front();
+            requests.pop_front();
+            busy = true;
+            lock.unlock();
+
+            RasterizedGlyph g = rasterize(key);
+
+            lock.lock();
+            finished.push_back(move(g));
+            busy = false;
+            if (requests.empty())
+                idleCv.notify_all();
+        }
+    }
+};
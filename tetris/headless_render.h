@@ -0,0 +1,89 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "bot.h"
+#include "soft_renderer.h"
+#include "tetris.h"
+#include "text_renderer.h"
+
+using namespace std;
+using namespace glm;
+
+struct HeadlessRenderConfig
+{
+    int frames;
+    int threads;
+    int width;
+    int height;
+    uint64_t seed;
+    GlyphMode glyphMode;
+    string outPath; // last frame as a ppm, empty for none
+};
+
+// Plays a bot game and draws the same sprites as Tetris::run into a
+// SoftRenderer, one bot move per frame. Prints render times and the hash of
+// the last frame, which only depends on the seed and the frame count.
+inline int runHeadlessRender(const HeadlessRenderConfig &config)
+{
+    SoftRenderer renderer(config.width, config.height, config.threads);
+    mat4 ortho = glm::ortho(0.0f, (float)config.width, (float)config.height, 0.0f, 0.1f, 100.0f);
+    mat4 view = glm::translate(mat4(1.0), vec3(0.0f, 0.0f, -3.0f));
+
+    TextRenderer textRenderer("resources/font/Roboto/Roboto-Regular.ttf", config.glyphMode, RENDER_SOFTWARE);
+    TextObject label(&textRenderer, vec3(300.0f, 300.0f, 0.0f), vec3(1.0, 1.0, 1.0));
+    label.setText("abcdefghijk");
+    // no frame may depend on how fast the glyph worker was
+    textRenderer.waitForGlyphs();
+    renderer.bindTexture(textRenderer.atlas.textureId, &textRenderer.atlas.pixels, textRenderer.atlas.width(),
+                         config.glyphMode == GLYPH_SDF ? GLYPH_SDF_SPREAD : 0.0f);
+
+    Arena arena(vec2(100, 0), 300, config.seed);
+    HeuristicEvaluator evaluator;
+    Bot bot(&evaluator, 0, 60000.0);
+    arena.moveDown(); // force to spawn
+
+    vector<double> frameMs;
+    frameMs.reserve(config.frames);
+    for (int frame = 0; frame < config.frames; ++frame)
+    {
+        bot.play(arena);
+
+        auto start = chrono::steady_clock::now();
+        textRenderer.beginFrame();
+        renderer.beginFrame(vec4(0.2f, 0.3f, 0.3f, 1.0f));
+        renderer.render(arena.renderPreview(), view, ortho);
+        renderer.render(arena.render(), view, ortho);
+        renderer.render(arena.renderBoundary(), view, ortho);
+        renderer.render(label.sprites(), view, ortho);
+        renderer.endFrame();
+        frameMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+
+    if (frameMs.empty())
+        return 0;
+    double total = 0.0;
+    for (double ms : frameMs)
+    {
+        total += ms;
+    }
+    sort(frameMs.begin(), frameMs.end());
+    double mean = total / frameMs.size();
+    cout << "software render...: " << config.frames << " frames at " << config.width << "x" << config.height << ", "
+         << config.threads << " threads, " << renderer.spritesDrawn << " sprites, " << mean << " ms mean, "
+         << frameMs[frameMs.size() * 99 / 100] << " ms p99, " << 1000.0 / mean << " fps, frame hash " << hex
+         << renderer.hash() << dec << endl;
+
+    if (!config.outPath.empty() && !renderer.writePpm(config.outPath))
+    {
+        cout << "unable to write " << config.outPath << endl;
+        return 1;
+    }
+    return 0;
+}
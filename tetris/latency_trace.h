@@ -0,0 +1,227 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <ostream>
+#include <stdint.h>
+
+#include "frame_pacer.h"
+
+using namespace std;
+
+// histogram buckets up to 250 ms, the last one also holds everything slower
+#define LATENCY_HISTOGRAM_BUCKETS 1000
+#define LATENCY_HISTOGRAM_BUCKET_MS 0.25
+// gpu timestamp queries in flight, the driver usually answers within two frames
+#define LATENCY_GPU_QUERIES 8
+
+// Millisecond latencies in fixed width buckets, so adding one never
+// allocates and percentiles come out to a bucket's width.
+class LatencyHistogram
+{
+public:
+    uint32_t counts[LATENCY_HISTOGRAM_BUCKETS] = {};
+    uint64_t count = 0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+
+    void add(double ms)
+    {
+        ms = std::max(ms, 0.0);
+        counts[std::min((int)(ms / LATENCY_HISTOGRAM_BUCKET_MS), LATENCY_HISTOGRAM_BUCKETS - 1)]++;
+        count++;
+        totalMs += ms;
+        maxMs = std::max(maxMs, ms);
+    }
+
+    // the upper edge of the bucket the p-th sample falls in, p from 0 to 1, past the last bucket the max
+    double percentile(double p) const
+    {
+        if (count == 0)
+            return 0.0;
+        uint64_t rank = std::min((uint64_t)(p * count), count - 1);
+        uint64_t seen = 0;
+        for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i)
+        {
+            seen += counts[i];
+            if (seen > rank)
+                return i == LATENCY_HISTOGRAM_BUCKETS - 1 ? maxMs : std::min((i + 1) * LATENCY_HISTOGRAM_BUCKET_MS, maxMs);
+        }
+        return maxMs;
+    }
+
+    double meanMs() const
+    {
+        return count == 0 ? 0.0 : totalMs / count;
+    }
+};
+
+// how far a key press got, each measured from the press in keyCallback
+enum LatencyStage
+{
+    LATENCY_APPLIED,  // the sim thread applied it in a tick
+    LATENCY_BUILT,    // a frame showing it has its sprites built and submitted
+    LATENCY_SWAPPED,  // that frame's glfwSwapBuffers returned
+    LATENCY_GPU_DONE, // the gpu finished drawing that frame, with gpu timestamps on
+    LATENCY_STAGES,
+};
+
+inline const char *latencyStageName(LatencyStage stage)
+{
+    switch (stage)
+    {
+    case LATENCY_APPLIED:
+        return "applied";
+    case LATENCY_BUILT:
+        return "built";
+    case LATENCY_SWAPPED:
+        return "swapped";
+    case LATENCY_GPU_DONE:
+        return "gpu";
+    default:
+        return "";
+    }
+}
+
+// the newest key press the sim thread applied, carried to the renderer in the snapshot
+struct InputTrace
+{
+    uint32_t id; // 0 before the first press
+    int64_t pressed; // FramePacer::now() microseconds in keyCallback
+    int64_t applied; // and when the tick applied it
+};
+
+// Render thread side of input to photon tracing. The first frame drawn
+// from a snapshot with a new InputTrace is followed through building,
+// the swap and optionally the gpu finishing it, each stage going into its
+// own histogram. Presses that a later one overtook before any frame drew
+// them are not counted. What the display does after the swap is out of
+// reach, so the swap and gpu stages are the closest there is to the photon.
+class LatencyTracer
+{
+public:
+    LatencyHistogram stages[LATENCY_STAGES];
+
+    // when the gl context has GL_TIMESTAMP queries and they were asked for
+    LatencyTracer(bool gpuTimestamps)
+    {
+        this->gpuTimestamps = gpuTimestamps && (GLVersion.major > 3 || (GLVersion.major == 3 && GLVersion.minor >= 3));
+        if (this->gpuTimestamps)
+        {
+            glGenQueries(LATENCY_GPU_QUERIES, queries);
+            calibrate();
+        }
+    }
+
+    ~LatencyTracer()
+    {
+        if (gpuTimestamps)
+            glDeleteQueries(LATENCY_GPU_QUERIES, queries);
+    }
+
+    LatencyTracer(const LatencyTracer &) = delete;
+    LatencyTracer &operator=(const LatencyTracer &) = delete;
+
+    bool hasGpuTimestamps() const
+    {
+        return gpuTimestamps;
+    }
+
+    // a frame is about to draw this snapshot's trace, false if it was drawn before
+    bool beginFrame(const InputTrace &trace)
+    {
+        if (trace.id == 0 || trace.id == lastId)
+            return false;
+        lastId = trace.id;
+        current = trace;
+        tracing = true;
+        stages[LATENCY_APPLIED].add((trace.applied - trace.pressed) * 0.001);
+        return true;
+    }
+
+    // every draw call of the traced frame is in, time in FramePacer::now() seconds
+    void built(double time)
+    {
+        if (!tracing)
+            return;
+        stages[LATENCY_BUILT].add(time * 1000.0 - current.pressed * 0.001);
+        if (gpuTimestamps && inFlight < LATENCY_GPU_QUERIES)
+        {
+            int slot = (firstInFlight + inFlight) % LATENCY_GPU_QUERIES;
+            glQueryCounter(queries[slot], GL_TIMESTAMP);
+            pressedAt[slot] = current.pressed;
+            inFlight++;
+        }
+    }
+
+    void swapped(double time)
+    {
+        if (!tracing)
+            return;
+        stages[LATENCY_SWAPPED].add(time * 1000.0 - current.pressed * 0.001);
+        tracing = false;
+    }
+
+    // picks up the gpu timestamps that are ready without waiting on the rest
+    void poll()
+    {
+        while (inFlight > 0)
+        {
+            GLuint query = queries[firstInFlight];
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 gpuTime = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+            stages[LATENCY_GPU_DONE].add((gpuTime * 1e-9 + gpuToCpu) * 1000.0 - pressedAt[firstInFlight] * 0.001);
+            firstInFlight = (firstInFlight + 1) % LATENCY_GPU_QUERIES;
+            inFlight--;
+        }
+    }
+
+    // the gpu clock drifts from the cpu one, call now and then
+    void calibrate()
+    {
+        if (!gpuTimestamps)
+            return;
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuToCpu = FramePacer::now() - gpuNow * 1e-9;
+    }
+
+    // one line per stage, then every non empty bucket of every stage
+    void dump(ostream &out) const
+    {
+        out << "# stage count mean_ms p50_ms p90_ms p99_ms max_ms" << endl;
+        for (int s = 0; s < LATENCY_STAGES; ++s)
+        {
+            const LatencyHistogram &h = stages[s];
+            out << latencyStageName((LatencyStage)s) << " " << h.count << " " << h.meanMs() << " "
+                << h.percentile(0.5) << " " << h.percentile(0.9) << " " << h.percentile(0.99) << " " << h.maxMs
+                << endl;
+        }
+        out << "# stage bucket_start_ms count" << endl;
+        for (int s = 0; s < LATENCY_STAGES; ++s)
+        {
+            for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i)
+            {
+                if (stages[s].counts[i] != 0)
+                    out << latencyStageName((LatencyStage)s) << " " << i * LATENCY_HISTOGRAM_BUCKET_MS << " "
+                        << stages[s].counts[i] << endl;
+            }
+        }
+    }
+
+private:
+    bool gpuTimestamps;
+    uint32_t lastId = 0;
+    InputTrace current = {};
+    bool tracing = false;
+
+    GLuint queries[LATENCY_GPU_QUERIES];
+    int64_t pressedAt[LATENCY_GPU_QUERIES];
+    int firstInFlight = 0;
+    int inFlight = 0;
+    double gpuToCpu = 0.0; // seconds to add to a gpu timestamp for FramePacer::now()
+};
@@ -13,17 +13,33 @@
 #include <tuple>
 #include <filesystem>
 #include <time.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <thread>
 #include <mutex>
 #include <queue>
+#include <unordered_set>
 #include <atomic>
+#include <chrono>
 
-#include "timer.h"
 #include "text_renderer.h"
 #include "sprite_renderer.h"
 #include "tetris.h"
 #include "util.h"
+#include "bench.h"
+#include "tournament.h"
+#include "headless_render.h"
+#include "board_texture.h"
+#include "sim.h"
+#include "triple_buffer.h"
+#include "spsc_queue.h"
+#include "frame_stats.h"
+#include "frame_pacer.h"
+#include "fixed_timestep.h"
+#include "latency_trace.h"
+#include "frame_allocator.h"
+// allocationCount, defined with the counting operator new in alloc_counter.cpp
+#include "alloc_counter.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -37,12 +53,35 @@ using namespace glm;
 const int serverTickMs = 1000;
 const int windowWidth = 800;
 const int windowHeight = 800;
-const float moveTickTime = 0.08f;
-const float moveTickFirstSticky = 0.2f;
+
+// key presses waiting for the sim thread, far more than a tick ever sees
+#define INPUT_QUEUE_SIZE 256
+
+// how the windowed game runs and draws, picked on the command line
+struct RenderOptions
+{
+    GlyphMode glyphMode;
+    bool boardTexture; // each board as one quad over a cell texture instead of a sprite per cell
+    PacingMode pacing;
+    int maxFps; // for PACING_CAPPED
+    bool interpolate; // the falling block slides between cells over a tick
+    bool fastForward; // the sim runs ticks back to back instead of at SIM_TICKS_PER_SECOND
+    bool gpuTimestamps; // latency tracing also times when the gpu finishes a frame
+    string latencyOut; // latency histograms are written here on exit, empty for none
+    bool debugOverlay; // heap allocations and frame memory drawn in the corner
+};
 
 struct Args
 {
     bool dedicatedServer;
+    bool runBenchmarks;
+    uint64_t seed;
+    RenderOptions render;
+
+    int tournamentGames;
+    TournamentConfig tournament;
+
+    HeadlessRenderConfig headless;
 
     string hostIp;
     int hostPort;
@@ -54,6 +93,25 @@ bool handleArgs(Args *args, int argc, char *argv[])
     Options options("Tetris", "a heartpounding versus tetris game");
     options.add_options()
         ("s,server", "Enable dedicated server", value<bool>()->default_value("false"))
+        ("b,bench", "Run the headless benchmarks and exit", value<bool>()->default_value("false"))
+        ("sdf-text", "Draw text from distance field glyphs that scale to any size", value<bool>()->default_value("false"))
+        ("board-texture", "Draw the board as one quad over a texture of its cells", value<bool>()->default_value("false"))
+        ("pacing", "Frame pacing: vsync, capped (see --fps) or uncapped", value<string>()->default_value("vsync"))
+        ("fps", "Frames per second with --pacing capped", value<int>()->default_value("120"))
+        ("interpolate", "Draw the falling block between ticks", value<bool>()->default_value("true"))
+        ("fast-forward", "Run the game as fast as the simulation goes", value<bool>()->default_value("false"))
+        ("gpu-timestamps", "Trace input latency up to the gpu finishing the frame", value<bool>()->default_value("false"))
+        ("latency-out", "Write the input latency histograms here on exit", value<string>()->default_value(""))
+        ("debug-overlay", "Draw heap allocations per frame in the corner", value<bool>()->default_value("false"))
+        ("seed", "Seed for the piece sequence, 0 picks one from the clock", value<uint64_t>()->default_value("0"))
+        ("t,tournament", "Run <n> headless bot games and exit", value<int>()->default_value("0"))
+        ("software", "Render <n> frames of a bot game with the software rasterizer and exit", value<int>()->default_value("0"))
+        ("frame-out", "Software rendering writes its last frame here", value<string>()->default_value("frame.ppm"))
+        ("threads", "Tournament and software rendering worker threads, 0 uses every core", value<int>()->default_value("0"))
+        ("max-pieces", "Tournament games end after this many pieces", value<int>()->default_value("5000"))
+        ("lookahead", "Tournament bot lookahead into the next queue", value<int>()->default_value("0"))
+        ("tt-mb", "Tournament bot transposition table size per thread in MB, 0 disables it", value<int>()->default_value("0"))
+        ("out", "Tournament results file", value<string>()->default_value("tournament.bin"))
         ("c,client", "Connect to a given <ip>:<port> server", value<string>()->default_value("")),
         ("h,help", "Print usage");
     auto result = options.parse(argc, argv);
@@ -65,6 +123,53 @@ bool handleArgs(Args *args, int argc, char *argv[])
 
 
     args->dedicatedServer = result["server"].as<bool>();
+    args->runBenchmarks = result["bench"].as<bool>();
+    args->render.glyphMode = result["sdf-text"].as<bool>() ? GLYPH_SDF : GLYPH_BITMAP;
+    args->render.boardTexture = result["board-texture"].as<bool>();
+    string pacing = result["pacing"].as<string>();
+    if (pacing == "vsync")
+        args->render.pacing = PACING_VSYNC;
+    else if (pacing == "capped")
+        args->render.pacing = PACING_CAPPED;
+    else if (pacing == "uncapped")
+        args->render.pacing = PACING_UNCAPPED;
+    else
+    {
+        cout << "unknown pacing " << pacing << endl;
+        return false;
+    }
+    args->render.maxFps = std::max(1, result["fps"].as<int>());
+    args->render.interpolate = result["interpolate"].as<bool>();
+    args->render.fastForward = result["fast-forward"].as<bool>();
+    args->render.gpuTimestamps = result["gpu-timestamps"].as<bool>();
+    args->render.latencyOut = result["latency-out"].as<string>();
+    args->render.debugOverlay = result["debug-overlay"].as<bool>();
+    args->seed = result["seed"].as<uint64_t>();
+    if (args->seed == 0)
+    {
+        args->seed = (uint64_t)time(NULL);
+    }
+
+    args->tournamentGames = result["tournament"].as<int>();
+    args->tournament.games = args->tournamentGames;
+    args->tournament.threads = result["threads"].as<int>();
+    if (args->tournament.threads <= 0)
+    {
+        args->tournament.threads = (int)std::max(1u, thread::hardware_concurrency());
+    }
+    args->tournament.maxPieces = result["max-pieces"].as<int>();
+    args->tournament.lookahead = result["lookahead"].as<int>();
+    args->tournament.tableMegabytes = result["tt-mb"].as<int>();
+    args->tournament.seed = args->seed;
+    args->tournament.outPath = result["out"].as<string>();
+
+    args->headless.frames = result["software"].as<int>();
+    args->headless.threads = args->tournament.threads;
+    args->headless.width = windowWidth;
+    args->headless.height = windowHeight;
+    args->headless.seed = args->seed;
+    args->headless.glyphMode = args->render.glyphMode;
+    args->headless.outPath = result["frame-out"].as<string>();
     vector<string> host = stringSplit(result["client"].as<string>(), ":");
     args->hostIp = host.size() >= 1 ? host[0] : "none";
     try
@@ -76,6 +181,7 @@ bool handleArgs(Args *args, int argc, char *argv[])
         args->hostPort = 0;
     }
 
+    cout << "seed: " << args->seed << endl;
     cout << "client: " << args->hostIp << ":"  << args->hostPort << " " << endl;
 
     return true;
@@ -198,7 +304,7 @@ public:
         // should send message to server here
     }
 
-    void onPlace(Block *b, unordered_set<int> *checkY) override
+    void onPlace(Block *b, RowSet checkY) override
     {
         //cout << "on place" << endl;
     }
@@ -210,121 +316,128 @@ public:
 
 };
 
-class Input
-{
-public:
-    Input() : moveLeftTimer(moveTickTime, moveTickFirstSticky), moveRightTimer(moveTickTime, moveTickFirstSticky)
-    {
-        moveDownMin = 0.04f;
-        moveDownMax = 0.5f;
-        moveDownThershold = moveDownMax; // 1 second then tick down
-        moveDownTime = 0.0f;
-    }
-
-    Timer moveLeftTimer;
-    Timer moveRightTimer;
-    Arena *arena;
-    bool shouldMoveFaster = false; 
+typedef SpscQueue<InputEvent, INPUT_QUEUE_SIZE> InputQueue;
 
-    float moveDownMin;
-    float moveDownMax;
-    float moveDownThershold;
-    float moveDownTime;
+// runs on the main thread, only queues the key for the sim thread
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS && action != GLFW_RELEASE)
+        return;
 
-    void timerTicks(float deltaTime)
+    InputKey inputKey;
+    switch (key)
     {
-        moveLeftTimer.tick(deltaTime);
-        moveRightTimer.tick(deltaTime);
+    case GLFW_KEY_LEFT:
+        inputKey = INPUT_LEFT;
+        break;
+    case GLFW_KEY_RIGHT:
+        inputKey = INPUT_RIGHT;
+        break;
+    case GLFW_KEY_DOWN:
+        inputKey = INPUT_SOFT_DROP;
+        break;
+    case GLFW_KEY_SPACE:
+        inputKey = INPUT_ROTATE;
+        break;
+    case GLFW_KEY_UP:
+        inputKey = INPUT_HARD_DROP;
+        break;
+    case GLFW_KEY_P:
+        inputKey = INPUT_PAUSE;
+        break;
+    default:
+        return;
     }
 
-    void handleMoveDown(float deltaTime)
-    {
-        if (shouldMoveFaster)
-            moveDownThershold = moveDownMin;
-        else
-            moveDownThershold = moveDownMax;
-        moveDownTime += deltaTime;
-
-        if (moveDownTime >= moveDownThershold)
-        {
-            moveDownTime = 0;
-            arena->moveDown();
-        }
-    }
-};
+    // ids for latency tracing, key callbacks all come in on the main thread
+    static uint32_t nextId = 1;
+    InputQueue *events = static_cast<InputQueue *>(glfwGetWindowUserPointer(window));
+    // stamped here, the sim thread places it inside the tick it falls in
+    events->push(InputEvent{inputKey, action == GLFW_PRESS, (int64_t)(FramePacer::now() * 1000000.0), nextId++});
+}
 
-void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+// what the sim thread hands the render thread after every tick
+struct GameSnapshot
 {
-    Input *input = static_cast<Input *>(glfwGetWindowUserPointer(window));
-    if (key == GLFW_KEY_LEFT)
-    {
-        if (action == GLFW_PRESS)
-        {
-            input->moveLeftTimer.addExec(1);
-            input->moveLeftTimer.start();
-        }
-        else if (action == GLFW_RELEASE)
-        {
-            input->moveLeftTimer.stop();
-        }
-    }
-    else if (key == GLFW_KEY_RIGHT)
-    {
-        if (action == GLFW_PRESS)
-        {
-            input->moveRightTimer.addExec(1);
-            input->moveRightTimer.start();
-        }
-        else if (action == GLFW_RELEASE)
-        {
-            input->moveRightTimer.stop();
-        }
-    }
-    else if (key == GLFW_KEY_DOWN)
-    {
-        if (action == GLFW_PRESS)
-        {
-            input->shouldMoveFaster = true;
-        }
-        else if (action == GLFW_RELEASE)
-        {
-            input->shouldMoveFaster = false;
-        }
-    }
-    else if (key == GLFW_KEY_SPACE)
-    {
-        if (action == GLFW_PRESS)
-        {
-            input->arena->rotate();
-        }
-    }
-}
+    ArenaSnapshot arena;
+    uint64_t tick;
+    double time; // FramePacer::now() of the tick, where drawing between ticks starts
+    uint64_t droppedTicks;
+    bool paused;
+    FrameTimeSummary tickStats; // over the last second of ticks
+    InputTrace input; // the newest key press applied so far
+};
 
+// The game on two threads. The sim thread owns arena and input and ticks
+// them SIM_TICKS_PER_SECOND times a second off a FixedTimestep, publishing
+// a GameSnapshot after each batch of ticks. The main thread polls glfw,
+// queues key events for the sim thread and draws the newest snapshot
+// through shown, so a slow swap never holds up a tick and a slow tick never
+// holds up a frame.
 class Tetris
 {
 public:
     GLFWwindow *window;
-    SpriteRenderer spriteRenderer;
+    // before the sprite renderer, the glyph worker rasterizes the prewarm
+    // charset while its shaders compile
     TextRenderer textRenderer;
-    Arena arena;
-    Input input;
+    TextObject label;
+    SpriteRenderer spriteRenderer;
+    LatencyTracer latency;
+    string latencyOut;
+    // sprite lists put together for one frame, reset once it is presented
+    FrameAllocator frame;
+    bool debugOverlay;
+    Arena arena; // sim thread only once run() started
+    Arena shown; // main thread, never ticked, only loads snapshots
+    PlayerInput input;
+
+    InputQueue inputEvents;
+    TripleBuffer<GameSnapshot> snapshots;
+    atomic_bool stopSim;
+
+    FramePacer pacer;
+    bool interpolate;
+    bool fastForward;
 
     mat4 ortho;
     mat4 view;
 
-    Tetris(SelectedBlockChangeListener *sbcl) : arena(vec2(100, 0), 300), window(createWindow()), spriteRenderer(), 
-        textRenderer("resources/font/Roboto/Roboto-Regular.ttf")
+    // only with RenderOptions::boardTexture
+    unique_ptr<BoardTexture> boardTexture;
+
+    Tetris(SelectedBlockChangeListener *sbcl, uint64_t seed, RenderOptions options)
+        : arena(vec2(100, 0), 300, seed), shown(vec2(100, 0), 300, seed), window(createWindow()),
+        textRenderer("resources/font/Roboto/Roboto-Regular.ttf", options.glyphMode),
+        label(&textRenderer, vec3(300.0f, 300.0f, 0.0f), vec3(1.0, 1.0, 1.0)), spriteRenderer(),
+        latency(options.gpuTimestamps), latencyOut(options.latencyOut), debugOverlay(options.debugOverlay), stopSim(false),
+        input(&arena), pacer(options.pacing, options.maxFps), interpolate(options.interpolate),
+        fastForward(options.fastForward)
     {
         if (window == nullptr)
         {
             cout << "window creation failed" << endl;
             return;
         }
+        glfwSwapInterval(options.pacing == PACING_VSYNC ? 1 : 0);
+
+        if (textRenderer.mode() == GLYPH_SDF)
+        {
+            spriteRenderer.setTextureShader(textRenderer.atlas.textureId, SHADER_DISTANCE_FIELD);
+        }
+        if (options.boardTexture)
+        {
+            boardTexture = make_unique<BoardTexture>();
+            spriteRenderer.setTextureShader(boardTexture->textureId, SHADER_CELLS);
+        }
 
         arena.moveDown(); // force to spawn
-        input.arena = &arena;
 
-        glfwSetWindowUserPointer(window, &input);
+        ArenaSnapshot first;
+        arena.saveSnapshot(first);
+        shown.loadSnapshot(first);
+
+        glfwSetWindowUserPointer(window, &inputEvents);
         glfwSetKeyCallback(window, keyCallback);
 
         ortho = glm::ortho(0.0f, (float)windowWidth, (float)windowHeight, 0.0f, 0.1f, 100.0f);
@@ -332,6 +445,7 @@ public:
         view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
 
         arena.sbcl = sbcl;
+        label.setText("abcdefghijk");
     }
 
     ~Tetris()
@@ -342,42 +456,235 @@ public:
 
     void run()
     {
-        float lastTime = glfwGetTime();
+        stopSim = false;
+        thread simThread(&Tetris::simulate, this);
+
+        // jitter is how much each frame interval differs from the one before
+        FrameTimeStats frameStats;
+        FrameTimeStats jitterStats;
+        FrameTimeSummary tickStats = {};
+        uint64_t droppedTicks = 0;
+        uint64_t tick = 0;
+        uint64_t statsTick = 0;
+        bool paused = false;
+        double lastTime = FramePacer::now();
+        double lastInterval = 0.0;
+        double statsTime = lastTime;
+        double statsCpu = processCpuSeconds();
+        // operator new calls by the whole process during a frame, less the title's own
+        uint64_t frameAllocations = 0;
+        uint64_t maxFrameAllocations = 0;
+        // the falling block's last step, drawn sliding from its old cell over one tick
+        vec2 slide = vec2(0.0f);
+        double slideStart = lastTime;
+        pacer.restart();
         while (!glfwWindowShouldClose(window))
         {
-            // Delta time
-            float currTime = glfwGetTime();
-            float deltaTime = currTime - lastTime;
+            uint64_t allocationsBefore = allocationCount.load(memory_order_relaxed);
+            uint64_t titleAllocations = 0;
+            double currTime = FramePacer::now();
+            double interval = currTime - lastTime;
+            frameStats.add(interval * 1000.0);
+            jitterStats.add(fabs(interval - lastInterval) * 1000.0);
             lastTime = currTime;
+            lastInterval = interval;
 
-            // Input
-            input.timerTicks(deltaTime);
-            input.handleMoveDown(deltaTime);
-            for (int i = 0; i < input.moveLeftTimer.consumeExec(); ++i)
+            if (snapshots.fetch())
             {
-                arena.moveHorizontal(true, false);
-            }
-            for (int i = 0; i < input.moveRightTimer.consumeExec(); ++i)
-            {
-                arena.moveHorizontal(false, true);
+                const GameSnapshot &snapshot = snapshots.readBuffer();
+                optional<Block> before = shown.selected;
+                ivec2 beforeIndex = shown.selectedIndex;
+                shown.loadSnapshot(snapshot.arena);
+                tickStats = snapshot.tickStats;
+                droppedTicks = snapshot.droppedTicks;
+                tick = snapshot.tick;
+                paused = snapshot.paused;
+                latency.beginFrame(snapshot.input);
+
+                // one cell over, a rotation, a new block or a hard drop just appear
+                ivec2 step = beforeIndex - shown.selectedIndex;
+                bool slides = interpolate && before && shown.selected && before->sameAs(*shown.selected) &&
+                              std::abs(step.x) <= 1 && std::abs(step.y) <= 1;
+                slide = slides ? vec2(step) * shown.getBlockSize() : vec2(0.0f);
+                slideStart = snapshot.time;
             }
+            double alpha = std::min(std::max((currTime - slideStart) * SIM_TICKS_PER_SECOND, 0.0), 1.0);
+            vec2 fallingOffset = slide * (float)(1.0 - alpha);
 
             // Render
+            spriteRenderer.beginFrame();
+            textRenderer.beginFrame();
             glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT);
 
-            auto previewSprites = arena.renderPreview();
+            uint64_t regeneratedBefore = shown.spritesRegenerated;
+            const auto &previewSprites = shown.renderPreview();
             spriteRenderer.render(previewSprites, view, ortho);
-            auto arenaSprites = arena.render();
-            spriteRenderer.render(arenaSprites, view, ortho);
-            auto arenaBoundarySprites = arena.renderBoundary();
+            if (boardTexture)
+            {
+                boardTexture->update(shown.board);
+                const auto &ghostSprites = shown.renderGhost();
+                const auto &fallingSprites = shown.renderFalling(fallingOffset);
+                span<Sprite> boardSprites = frame.allocate<Sprite>(ghostSprites.size() + fallingSprites.size() + 1);
+                auto out = copy(ghostSprites.begin(), ghostSprites.end(), boardSprites.begin());
+                out = copy(fallingSprites.begin(), fallingSprites.end(), out);
+                *out = shown.renderBoard(boardTexture->textureId);
+                spriteRenderer.render(boardSprites, view, ortho);
+            }
+            else
+            {
+                const auto &arenaSprites = shown.render(fallingOffset);
+                spriteRenderer.render(arenaSprites, view, ortho);
+            }
+            const auto &arenaBoundarySprites = shown.renderBoundary();
             spriteRenderer.render(arenaBoundarySprites, view, ortho);
+            int spritesRegenerated = (int)(shown.spritesRegenerated - regeneratedBefore);
 
-            auto textSprites = textRenderer.layoutText(vec3(300.0f, 300.0f, 0.0f), "abcdefghijk", vec3(1.0, 1.0, 1.0));
-            spriteRenderer.render(textSprites, view, ortho);
+            spriteRenderer.render(label.sprites(), view, ortho);
+
+            // the lines read the same most frames, so they come from the text run cache
+            if (debugOverlay)
+            {
+                char overlay[128];
+                snprintf(overlay, sizeof(overlay), "%llu allocs last frame, %llu max this second, frame memory %zu of %zu KB",
+                         (unsigned long long)frameAllocations, (unsigned long long)maxFrameAllocations,
+                         frame.highWater / 1024, frame.size() / 1024);
+                spriteRenderer.render(
+                    textRenderer.layoutTextCached(frame, vec3(10.0f, 30.0f, 0.0f), overlay, vec3(1.0f), 20), view, ortho);
+                const LatencyHistogram &swapLatency = latency.stages[LATENCY_SWAPPED];
+                snprintf(overlay, sizeof(overlay), "key to swap p50 %.2f p99 %.2f ms, text runs %zu cached",
+                         swapLatency.percentile(0.5), swapLatency.percentile(0.99), textRenderer.runCache.size());
+                spriteRenderer.render(
+                    textRenderer.layoutTextCached(frame, vec3(10.0f, 56.0f, 0.0f), overlay, vec3(1.0f), 20), view, ortho);
+            }
+            latency.built(FramePacer::now());
+
+            // once a second, the last frame's renderer stats and both threads' timings go in the title bar
+            if (currTime - statsTime >= 1.0)
+            {
+                uint64_t titleBefore = allocationCount.load(memory_order_relaxed);
+                double cpu = processCpuSeconds();
+                int cpuPercent = (int)((cpu - statsCpu) / (currTime - statsTime) * 100.0);
+                statsTime = currTime;
+                statsCpu = cpu;
+                FrameTimeSummary frames = frameStats.take();
+                FrameTimeSummary jitter = jitterStats.take();
+                uint64_t ticksPerSecond = tick - statsTick;
+                statsTick = tick;
+                latency.calibrate();
+                const LatencyHistogram &swapLatency = latency.stages[LATENCY_SWAPPED];
+                string title = "AleTetris - " + string(paused ? "paused, " : "") +
+                               to_string(spriteRenderer.drawCalls) + " draw calls, " +
+                               to_string(spriteRenderer.spritesDrawn) + " sprites, " +
+                               to_string(spritesRegenerated) + " regenerated, " +
+                               to_string(spriteRenderer.instanceStream.stalls) + " upload stalls, " +
+                               to_string(textRenderer.cacheMisses) + " glyph cache misses, " +
+                               to_string(label.layouts) + " text layouts, render " + to_string(frames.count) +
+                               " fps p50 " + to_string(frames.p50Ms) + " p99 " + to_string(frames.p99Ms) +
+                               " ms, sim " + to_string(ticksPerSecond) + " ticks/s " + to_string(droppedTicks) +
+                               " dropped p50 " +
+                               to_string(tickStats.p50Ms) + " p99 " + to_string(tickStats.p99Ms) + " ms, jitter p50 " +
+                               to_string(jitter.p50Ms) + " p99 " + to_string(jitter.p99Ms) + " ms, key to swap p50 " +
+                               to_string(swapLatency.percentile(0.5)) + " p99 " +
+                               to_string(swapLatency.percentile(0.99)) + " ms, " + to_string(maxFrameAllocations) +
+                               " allocs/frame max, cpu " + to_string(cpuPercent) + "%";
+                glfwSetWindowTitle(window, title.c_str());
+                maxFrameAllocations = 0;
+                titleAllocations = allocationCount.load(memory_order_relaxed) - titleBefore;
+            }
 
             glfwSwapBuffers(window);
-            glfwPollEvents();
+            latency.swapped(FramePacer::now());
+            latency.poll();
+            frame.reset();
+
+            // nothing moves while paused and a window in the background is not
+            // being played, so sleep in the event wait until a key or the timeout
+            bool idle = paused || !glfwGetWindowAttrib(window, GLFW_FOCUSED) ||
+                        glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+            if (idle)
+            {
+                glfwWaitEventsTimeout(1.0 / FRAME_PACER_IDLE_FPS);
+                pacer.restart();
+            }
+            else
+            {
+                glfwPollEvents();
+                pacer.wait();
+            }
+            frameAllocations = allocationCount.load(memory_order_relaxed) - allocationsBefore - titleAllocations;
+            maxFrameAllocations = std::max(maxFrameAllocations, frameAllocations);
+        }
+
+        stopSim = true;
+        simThread.join();
+
+        if (!latencyOut.empty())
+        {
+            ofstream out(latencyOut);
+            latency.dump(out);
+        }
+    }
+
+    // the sim thread, tick times are how long each tick took to run
+    void simulate()
+    {
+        FixedTimestep timestep(1.0 / SIM_TICKS_PER_SECOND, FIXED_TIMESTEP_MAX_CATCH_UP, fastForward);
+        FrameTimeStats tickStats;
+        FrameTimeSummary lastStats = {};
+        double last = FramePacer::now();
+        double statsTime = last;
+        // popped already but stamped after the tick that was running
+        InputEvent pending;
+        bool hasPending = false;
+        InputTrace trace = {};
+        while (!stopSim.load(memory_order_relaxed))
+        {
+            double now = FramePacer::now();
+            int ticks = timestep.advance(now - last);
+            last = now;
+            for (int i = 0; i < ticks; ++i)
+            {
+                double start = FramePacer::now();
+                // when this tick ends on the wall clock, the last one of the batch was due just now
+                int64_t tickEnd = (int64_t)((now - (timestep.alpha() + ticks - 1 - i) * timestep.tickSeconds) * 1000000.0);
+                while (hasPending || (hasPending = inputEvents.pop(pending)))
+                {
+                    if (!fastForward && pending.time >= tickEnd)
+                        break;
+                    if (pending.pressed)
+                        trace = InputTrace{pending.id, pending.time, (int64_t)(FramePacer::now() * 1000000.0)};
+                    // onto the simulation clock, the same distance before the end of the tick
+                    pending.time = input.tickEndMicros() - (tickEnd - pending.time);
+                    input.apply(pending);
+                    hasPending = false;
+                }
+                input.tick();
+                tickStats.add((FramePacer::now() - start) * 1000.0);
+            }
+
+            if (ticks > 0)
+            {
+                if (now - statsTime >= 1.0)
+                {
+                    statsTime = now;
+                    lastStats = tickStats.take();
+                }
+                GameSnapshot &snapshot = snapshots.writeBuffer();
+                arena.saveSnapshot(snapshot.arena);
+                snapshot.tick = timestep.ticks;
+                // when the last tick was due, the accumulator holds the time since
+                snapshot.time = now - timestep.alpha() * timestep.tickSeconds;
+                snapshot.droppedTicks = timestep.droppedTicks;
+                snapshot.paused = input.paused;
+                snapshot.tickStats = lastStats;
+                snapshot.input = trace;
+                snapshots.publish();
+            }
+
+            double wait = timestep.secondsUntilNextTick();
+            if (wait > 0.0)
+                this_thread::sleep_for(chrono::duration<double>(wait));
         }
     }
 };
@@ -480,10 +787,13 @@ class Client
 public:
     string hostIp;
     int hostPort;
+    uint64_t seed;
+    RenderOptions renderOptions;
     ENetHost *client;
     atomic_bool shouldQuit;
 
-    Client(string hostIp, int hostPort) : hostIp(hostIp), hostPort(hostPort), shouldQuit(false)
+    Client(string hostIp, int hostPort, uint64_t seed, RenderOptions renderOptions)
+        : hostIp(hostIp), hostPort(hostPort), seed(seed), renderOptions(renderOptions), shouldQuit(false)
     {
     }
 
@@ -505,7 +815,7 @@ public:
             bcr = new BlockChangeReplicator(serverPeer);
         }
 
-        Tetris tetris(bcr);
+        Tetris tetris(bcr, seed, renderOptions);
         tetris.run();
 
         shouldQuit = true;
@@ -554,14 +864,27 @@ public:
 
 int main(int argc, char *argv[])
 {
-    srand(time(NULL));
-
     Args args;
     if (!handleArgs(&args, argc, argv))
     {
         return -1;
     }
 
+    if (args.runBenchmarks)
+    {
+        return runBenchmarks();
+    }
+
+    if (args.tournamentGames > 0)
+    {
+        return runTournament(args.tournament);
+    }
+
+    if (args.headless.frames > 0)
+    {
+        return runHeadlessRender(args.headless);
+    }
+
     if (enet_initialize() != 0)
     {
         return -1;
@@ -574,7 +897,7 @@ int main(int argc, char *argv[])
     }
     else
     {
-        Client client(args.hostIp, args.hostPort);
+        Client client(args.hostIp, args.hostPort, args.seed, args.render);
         client.run();
     }
 }
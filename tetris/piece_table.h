@@ -0,0 +1,231 @@
+#pragma once
+#include <array>
+#include <utility>
+#include <stdint.h>
+
+#include "bitboard.h"
+
+using namespace std;
+
+#define PIECE_TYPES 7
+#define PIECE_MAX_ROTATIONS 4
+#define PIECE_CELLS 4
+
+//[TYPE][ROTATION][I][J], rotations past PIECE_ROTATIONS[TYPE] are left zeroed
+constexpr int PIECE_TEMPLATES[PIECE_TYPES][PIECE_MAX_ROTATIONS][4][4]{
+#define TYPE_Z 0
+    {{
+         {0, 0, 0, 0},
+         {0, 1, 1, 0},
+         {0, 0, 1, 1},
+         {0, 0, 0, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 1, 0},
+         {0, 1, 1, 0},
+         {0, 1, 0, 0},
+     }},
+#define TYPE_Z_ALT 1
+    {{
+         {0, 0, 0, 0},
+         {0, 0, 1, 1},
+         {0, 1, 1, 0},
+         {0, 0, 0, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 1, 0, 0},
+         {0, 1, 1, 0},
+         {0, 0, 1, 0},
+     }},
+#define TYPE_I 2
+    {{
+         {0, 0, 1, 0},
+         {0, 0, 1, 0},
+         {0, 0, 1, 0},
+         {0, 0, 1, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 0, 0},
+         {1, 1, 1, 1},
+         {0, 0, 0, 0},
+     }},
+#define TYPE_BOX 3
+    {{
+        {0, 0, 0, 0},
+        {0, 1, 1, 0},
+        {0, 1, 1, 0},
+        {0, 0, 0, 0},
+    }},
+#define TYPE_L 4
+    {{
+         {0, 0, 0, 0},
+         {0, 1, 0, 0},
+         {0, 1, 0, 0},
+         {0, 1, 1, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 0, 0},
+         {0, 1, 1, 1},
+         {0, 1, 0, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 1, 1, 0},
+         {0, 0, 1, 0},
+         {0, 0, 1, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 0, 0},
+         {0, 0, 1, 0},
+         {1, 1, 1, 0},
+     }},
+#define TYPE_L_ALT 5
+    {{
+         {0, 0, 0, 0},
+         {0, 0, 1, 0},
+         {0, 0, 1, 0},
+         {0, 1, 1, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 0, 0},
+         {1, 1, 1, 0},
+         {0, 0, 1, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 1, 1, 0},
+         {0, 1, 0, 0},
+         {0, 1, 0, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 0, 0},
+         {0, 1, 0, 0},
+         {0, 1, 1, 1},
+     }},
+#define TYPE_T 6
+    {{
+         {0, 0, 0, 0},
+         {0, 1, 0, 0},
+         {0, 1, 1, 0},
+         {0, 1, 0, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 0, 0},
+         {0, 1, 1, 1},
+         {0, 0, 1, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 1, 0},
+         {0, 1, 1, 0},
+         {0, 0, 1, 0},
+     },
+     {
+         {0, 0, 0, 0},
+         {0, 0, 1, 0},
+         {0, 1, 1, 1},
+         {0, 0, 0, 0},
+     }}
+    /***/};
+
+constexpr int PIECE_ROTATIONS[PIECE_TYPES] = {2, 2, 2, 1, 4, 4, 4};
+
+struct PieceCell
+{
+    int8_t x;
+    int8_t y;
+};
+
+// everything the movement path needs to know about one (type, rotation),
+// all coordinates are relative to the top left of the 4x4 template
+struct PieceShape
+{
+    PieceCell cells[PIECE_CELLS];
+    PieceMask mask;
+
+    // inclusive bounding box of the filled cells
+    int8_t minX, maxX;
+    int8_t minY, maxY;
+
+    // top left position of the template when the piece enters the arena
+    int8_t spawnX;
+    int8_t spawnY;
+};
+
+constexpr PieceShape makePieceShape(int type, int rotation)
+{
+    PieceShape shape = {};
+    shape.minX = shape.minY = 4;
+    shape.maxX = shape.maxY = -1;
+
+    int n = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            if (PIECE_TEMPLATES[type][rotation][i][j] == 0)
+                continue;
+            shape.cells[n++] = PieceCell{(int8_t)j, (int8_t)i};
+            shape.mask.rows[i] |= 1 << j;
+            shape.minX = j < shape.minX ? j : shape.minX;
+            shape.maxX = j > shape.maxX ? j : shape.maxX;
+            shape.minY = i < shape.minY ? i : shape.minY;
+            shape.maxY = i > shape.maxY ? i : shape.maxY;
+        }
+    }
+
+    shape.spawnX = ARENA_SIZE_X / 2 - 4 / 2;
+    shape.spawnY = 0;
+    return shape;
+}
+
+template <int Type>
+constexpr array<PieceShape, PIECE_MAX_ROTATIONS> makePieceRotations()
+{
+    array<PieceShape, PIECE_MAX_ROTATIONS> rotations = {};
+    for (int r = 0; r < PIECE_ROTATIONS[Type]; ++r)
+    {
+        rotations[r] = makePieceShape(Type, r);
+    }
+    return rotations;
+}
+
+template <int... Types>
+constexpr array<array<PieceShape, PIECE_MAX_ROTATIONS>, PIECE_TYPES> makePieceTable(integer_sequence<int, Types...>)
+{
+    return {makePieceRotations<Types>()...};
+}
+
+//[TYPE][ROTATION]
+constexpr array<array<PieceShape, PIECE_MAX_ROTATIONS>, PIECE_TYPES> PIECES =
+    makePieceTable(make_integer_sequence<int, PIECE_TYPES>{});
+
+constexpr bool pieceTableIsValid()
+{
+    for (int t = 0; t < PIECE_TYPES; ++t)
+    {
+        for (int r = 0; r < PIECE_ROTATIONS[t]; ++r)
+        {
+            int count = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                for (int j = 0; j < 4; ++j)
+                {
+                    count += PIECE_TEMPLATES[t][r][i][j];
+                }
+            }
+            if (count != PIECE_CELLS)
+                return false;
+        }
+    }
+    return true;
+}
+static_assert(pieceTableIsValid(), "every piece template must have exactly 4 cells");
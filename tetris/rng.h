@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+
+// SplitMix64, small enough to give every arena its own stream.
+// The same seed always produces the same pieces.
+class Rng
+{
+public:
+    uint64_t state;
+
+    explicit Rng(uint64_t seed) : state(seed)
+    {
+    }
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    int nextInt(int bound)
+    {
+        return (int)(next() % (uint64_t)bound);
+    }
+};
@@ -0,0 +1,251 @@
+#pragma once
+#include <algorithm>
+#include <stdint.h>
+
+#include "tetris.h"
+#include "timer.h"
+
+#define SIM_TICKS_PER_SECOND 120
+
+// auto shift: the first repeat after a press, then every repeat after it
+const float moveTickTime = 0.08f;
+const float moveTickFirstSticky = 0.2f;
+
+// everything a player can do during one tick
+struct SimInput
+{
+    int moveX; // -1 left, 1 right, 0 stay
+    bool rotate;
+    bool softDrop;
+    bool hardDrop;
+};
+
+inline int secondsToTicks(float seconds)
+{
+    int ticks = (int)(seconds * SIM_TICKS_PER_SECOND + 0.5f);
+    return ticks < 1 ? 1 : ticks;
+}
+
+// Gravity, in ticks between two moveDown, shorter while soft dropping.
+// Simulation and PlayerInput both count it here so they fall at the same pace.
+struct Gravity
+{
+    int minTicks = secondsToTicks(0.04f);
+    int maxTicks = secondsToTicks(0.5f);
+    int ticks = 0;
+
+    // one tick gone, true when the block has to move down
+    bool tick(bool softDrop)
+    {
+        ticks++;
+        if (ticks < (softDrop ? minTicks : maxTicks))
+            return false;
+        ticks = 0;
+        return true;
+    }
+
+    // a hard drop starts the count over
+    void reset()
+    {
+        ticks = 0;
+    }
+};
+
+// Headless, deterministic driver around Arena. There is no wall clock in here,
+// time only moves when step() is called, so the same seed and the same inputs
+// always end on the same board.
+class Simulation
+{
+public:
+    Arena arena;
+    uint64_t tickCount;
+    Gravity gravity;
+
+    Simulation(uint64_t seed) : arena(vec2(0.0f, 0.0f), 300, seed)
+    {
+        tickCount = 0;
+
+        arena.moveDown(); // force to spawn
+    }
+
+    void step(const SimInput &input)
+    {
+        if (gravity.tick(input.softDrop))
+        {
+            arena.moveDown();
+        }
+
+        if (input.moveX != 0)
+        {
+            arena.moveHorizontal(input.moveX < 0, input.moveX > 0);
+        }
+        if (input.rotate)
+        {
+            arena.rotate();
+        }
+        if (input.hardDrop)
+        {
+            arena.hardDrop();
+            gravity.reset();
+        }
+        tickCount++;
+    }
+};
+
+// the keys the game knows, the window maps its own key codes to these
+enum InputKey
+{
+    INPUT_LEFT,
+    INPUT_RIGHT,
+    INPUT_SOFT_DROP,
+    INPUT_ROTATE,
+    INPUT_HARD_DROP,
+    INPUT_PAUSE,
+};
+
+struct InputEvent
+{
+    InputKey key;
+    bool pressed;
+    // microseconds, on the producer's clock until it is moved onto the simulation clock
+    int64_t time;
+    uint32_t id; // for latency tracing, 0 when nobody traces it
+};
+
+// the simulation clock, in microseconds since tick 0 started
+inline int64_t tickStartMicros(uint64_t tick)
+{
+    return (int64_t)(tick * 1000000 / SIM_TICKS_PER_SECOND);
+}
+
+inline int64_t secondsToMicros(float seconds)
+{
+    return (int64_t)(seconds * 1000000.0f + 0.5f);
+}
+
+// A player at the keyboard. Key presses and releases come in through
+// apply() with their time on the simulation clock, in order, and each one
+// takes effect at that time: two taps inside one tick move twice, and auto
+// shift repeats fire at press + moveTickFirstSticky + n * moveTickTime
+// however the ticks and frames fall. Gravity moves on by whole ticks in
+// tick(). Nothing here reads a clock, so two machines fed the same events
+// end on the same board.
+class PlayerInput
+{
+public:
+    Timer moveLeftTimer;
+    Timer moveRightTimer;
+    Arena *arena;
+    bool shouldMoveFaster = false;
+    bool paused = false;
+
+    // ticks run so far, the current tick covers [tickStartMicros(ticks), tickStartMicros(ticks + 1))
+    uint64_t ticks = 0;
+    Gravity gravity;
+
+    PlayerInput(Arena *arena)
+        : moveLeftTimer(secondsToMicros(moveTickTime), secondsToMicros(moveTickFirstSticky)),
+          moveRightTimer(secondsToMicros(moveTickTime), secondsToMicros(moveTickFirstSticky)), arena(arena)
+    {
+    }
+
+    // where the current tick ends, events before this belong to it
+    int64_t tickEndMicros() const
+    {
+        return tickStartMicros(ticks + 1);
+    }
+
+    // events have to come in time order and before the tick() of the tick they fall in,
+    // ones from earlier than the events already applied count as happening now
+    void apply(const InputEvent &e)
+    {
+        int64_t time = std::min(std::max(e.time, now), tickEndMicros());
+        runAutoShift(time);
+        now = time;
+
+        // releases still count, a key let go during the pause must not keep repeating afterwards
+        if (paused && e.pressed && e.key != INPUT_PAUSE)
+            return;
+        switch (e.key)
+        {
+        case INPUT_LEFT:
+            if (e.pressed)
+            {
+                arena->moveHorizontal(true, false);
+                moveLeftTimer.start(time);
+            }
+            else
+            {
+                moveLeftTimer.stop();
+            }
+            break;
+        case INPUT_RIGHT:
+            if (e.pressed)
+            {
+                arena->moveHorizontal(false, true);
+                moveRightTimer.start(time);
+            }
+            else
+            {
+                moveRightTimer.stop();
+            }
+            break;
+        case INPUT_SOFT_DROP:
+            shouldMoveFaster = e.pressed;
+            break;
+        case INPUT_ROTATE:
+            if (e.pressed)
+                arena->rotate();
+            break;
+        case INPUT_HARD_DROP:
+            if (e.pressed)
+            {
+                arena->hardDrop();
+                gravity.reset();
+            }
+            break;
+        case INPUT_PAUSE:
+            if (e.pressed)
+            {
+                paused = !paused;
+                // held keys start over after a pause instead of catching up on its repeats
+                moveLeftTimer.stop();
+                moveRightTimer.stop();
+            }
+            break;
+        }
+    }
+
+    // the rest of the tick's auto shift, then gravity, the game stands still while paused
+    void tick()
+    {
+        int64_t end = tickEndMicros();
+        runAutoShift(end);
+        now = end;
+        ticks++;
+        if (paused)
+            return;
+
+        if (gravity.tick(shouldMoveFaster))
+            arena->moveDown();
+    }
+
+private:
+    // how far apply() and tick() got on the simulation clock
+    int64_t now = 0;
+
+    // every repeat due before time, oldest first
+    void runAutoShift(int64_t time)
+    {
+        if (paused)
+            return;
+        while (moveLeftTimer.due(time) || moveRightTimer.due(time))
+        {
+            bool left = moveLeftTimer.due(time) &&
+                        (!moveRightTimer.due(time) || moveLeftTimer.nextExec <= moveRightTimer.nextExec);
+            Timer &timer = left ? moveLeftTimer : moveRightTimer;
+            arena->moveHorizontal(left, !left);
+            timer.exec();
+        }
+    }
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <fstream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+
+#include "sprite.h"
+#include "task_pool.h"
+
+using namespace std;
+using namespace glm;
+
+// rows of the framebuffer one task rasterizes
+#define SOFT_STRIP_HEIGHT 32
+
+// a cpu side 8 bit texture, alpha for glyph bitmaps or a distance field
+struct SoftTexture
+{
+    const vector<uint8_t> *pixels; // a vector that can grow, like GlyphAtlas::pixels
+    int width;
+    // 0 for coverage, else the spread of the field in texels, see glyph_rasterizer.h
+    float distanceSpread;
+};
+
+// CPU stand-in for SpriteRenderer, for machines without a gpu. It takes the
+// same sprite lists and draws them like sprite.frag and sprite_sdf.frag with
+// SRC_ALPHA, ONE_MINUS_SRC_ALPHA blending into an RGBA8 framebuffer, rows top
+// to bottom. render() only records quads, endFrame() rasterizes the frame in
+// horizontal strips on a task pool, each strip drawing its quads in order.
+class SoftRenderer
+{
+public:
+    int width;
+    int height;
+    vector<uint32_t> pixels; // 0xAABBGGRR, so the bytes are R, G, B, A in memory
+
+    // since the last beginFrame()
+    int spritesDrawn = 0;
+
+    SoftRenderer(int width, int height, int threads = 1) : width(width), height(height), pool(threads)
+    {
+        pixels.assign((size_t)width * height, 0);
+        strips.resize((height + SOFT_STRIP_HEIGHT - 1) / SOFT_STRIP_HEIGHT);
+    }
+
+    // textures that are not bound draw like the 1x1 white dummy, a solid quad
+    void bindTexture(unsigned int textureId, const vector<uint8_t> *texels, int texWidth, float distanceSpread = 0.0f)
+    {
+        textures[textureId] = SoftTexture{texels, texWidth, distanceSpread};
+    }
+
+    void beginFrame(vec4 clearColor)
+    {
+        spritesDrawn = 0;
+        quads.clear();
+        clear = packColor(clearColor);
+    }
+
+    // same grouping as SpriteRenderer::render, textures in id order, list order inside one
+    void render(span<const Sprite> sprites, mat4 view, mat4 proj)
+    {
+        order.resize(sprites.size());
+        for (size_t i = 0; i < sprites.size(); ++i)
+        {
+            order[i] = (int)i;
+        }
+        sort(order.begin(), order.end(), [&](int a, int b) {
+            return sprites[a].textureId != sprites[b].textureId ? sprites[a].textureId < sprites[b].textureId : a < b;
+        });
+
+        mat4 transform = proj * view;
+        for (int i : order)
+        {
+            const Sprite &s = sprites[i];
+            vec2 a = toWindow(transform, s.position);
+            vec2 b = toWindow(transform, s.position + vec3(s.size, 0.0f));
+            auto it = textures.find(s.textureId);
+            quads.push_back(Quad{a, b, s.color, s.uv, it == textures.end() ? nullptr : &it->second});
+        }
+        spritesDrawn += (int)sprites.size();
+    }
+
+    void endFrame()
+    {
+        for (auto &strip : strips)
+        {
+            strip.clear();
+        }
+        for (int i = 0; i < (int)quads.size(); ++i)
+        {
+            int y0, y1;
+            rowSpan(quads[i], y0, y1);
+            if (y0 >= y1)
+                continue;
+            for (int s = y0 / SOFT_STRIP_HEIGHT; s <= (y1 - 1) / SOFT_STRIP_HEIGHT; ++s)
+            {
+                strips[s].push_back(i);
+            }
+        }
+
+        for (int s = 0; s < (int)strips.size(); ++s)
+        {
+            pool.submit([this, s] { drawStrip(s); });
+        }
+        pool.wait();
+    }
+
+    // FNV-1a over the framebuffer, for comparing frames against a golden hash
+    uint64_t hash() const
+    {
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (uint32_t p : pixels)
+        {
+            h = (h ^ p) * 0x100000001B3ull;
+        }
+        return h;
+    }
+
+    bool writePpm(const string &path) const
+    {
+        ofstream out(path, ios::binary);
+        if (!out)
+            return false;
+        out << "P6\n" << width << " " << height << "\n255\n";
+        vector<uint8_t> row(width * 3);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                uint32_t p = pixels[(size_t)y * width + x];
+                row[x * 3 + 0] = p & 0xFF;
+                row[x * 3 + 1] = (p >> 8) & 0xFF;
+                row[x * 3 + 2] = (p >> 16) & 0xFF;
+            }
+            out.write((const char *)row.data(), row.size());
+        }
+        return (bool)out;
+    }
+
+private:
+    // a sprite in window coordinates, y down
+    struct Quad
+    {
+        vec2 a; // where the sprite's position ended up
+        vec2 b; // and position + size
+        vec4 color;
+        vec4 uv;
+        const SoftTexture *texture;
+    };
+
+    TaskPool pool;
+    unordered_map<unsigned int, SoftTexture> textures;
+    vector<Quad> quads;
+    vector<vector<int>> strips; // quads touching each strip, in draw order
+    vector<int> order;
+    uint32_t clear = 0;
+
+    // gl's float to unorm conversion
+    static uint32_t unorm8(float f)
+    {
+        return (uint32_t)lroundf(std::clamp(f, 0.0f, 1.0f) * 255.0f);
+    }
+
+    static uint32_t packColor(vec4 c)
+    {
+        return unorm8(c.x) | unorm8(c.y) << 8 | unorm8(c.z) << 16 | unorm8(c.w) << 24;
+    }
+
+    vec2 toWindow(const mat4 &transform, vec3 p) const
+    {
+        vec4 clip = transform * vec4(p, 1.0f);
+        vec2 ndc = vec2(clip.x / clip.w, clip.y / clip.w);
+        // gl puts ndc y = 1 at the top row of the window
+        return vec2((ndc.x + 1.0f) * 0.5f * width, (1.0f - ndc.y) * 0.5f * height);
+    }
+
+    // Pixels whose centers are inside the quad. A center right on an edge is
+    // in for the left and bottom edges and out for the right and top ones, as
+    // gl decides it with its window origin at the bottom left.
+    static void columnSpan(float a, float b, int limit, int &lo, int &hi)
+    {
+        lo = std::max(0, (int)ceilf(std::min(a, b) - 0.5f));
+        hi = std::min(limit, (int)ceilf(std::max(a, b) - 0.5f));
+    }
+
+    void rowSpan(const Quad &q, int &y0, int &y1) const
+    {
+        y0 = std::max(0, (int)floorf(std::min(q.a.y, q.b.y) + 0.5f));
+        y1 = std::min(height, (int)floorf(std::max(q.a.y, q.b.y) + 0.5f));
+    }
+
+    // bilinear with clamp to edge, like GL_LINEAR on the atlas
+    static float sample(const SoftTexture &t, int texHeight, float u, float v)
+    {
+        const uint8_t *texels = t.pixels->data();
+        float x = u * t.width - 0.5f;
+        float y = v * texHeight - 0.5f;
+        int x0 = (int)floorf(x);
+        int y0 = (int)floorf(y);
+        float fx = x - x0;
+        float fy = y - y0;
+        int x1 = std::clamp(x0 + 1, 0, t.width - 1);
+        int y1 = std::clamp(y0 + 1, 0, texHeight - 1);
+        x0 = std::clamp(x0, 0, t.width - 1);
+        y0 = std::clamp(y0, 0, texHeight - 1);
+        float top = texels[(size_t)y0 * t.width + x0] * (1.0f - fx) + texels[(size_t)y0 * t.width + x1] * fx;
+        float bottom = texels[(size_t)y1 * t.width + x0] * (1.0f - fx) + texels[(size_t)y1 * t.width + x1] * fx;
+        return (top * (1.0f - fy) + bottom * fy) * (1.0f / 255.0f);
+    }
+
+    static uint32_t blend(uint32_t dst, uint32_t rgb, uint32_t alpha)
+    {
+        uint32_t inv = 255 - alpha;
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            uint32_t s = shift == 24 ? alpha : (rgb >> shift) & 0xFF;
+            uint32_t d = (dst >> shift) & 0xFF;
+            out |= ((s * alpha + d * inv + 127) / 255) << shift;
+        }
+        return out;
+    }
+
+    void drawStrip(int strip)
+    {
+        int top = strip * SOFT_STRIP_HEIGHT;
+        int bottom = std::min(height, top + SOFT_STRIP_HEIGHT);
+        fill(pixels.begin() + (size_t)top * width, pixels.begin() + (size_t)bottom * width, clear);
+
+        for (int index : strips[strip])
+        {
+            const Quad &q = quads[index];
+            int x0, x1, y0, y1;
+            columnSpan(q.a.x, q.b.x, width, x0, x1);
+            rowSpan(q, y0, y1);
+            y0 = std::max(y0, top);
+            y1 = std::min(y1, bottom);
+            if (x0 >= x1 || y0 >= y1)
+                continue;
+
+            uint32_t rgb = packColor(vec4(q.color.x, q.color.y, q.color.z, 0.0f));
+            if (q.texture == nullptr)
+            {
+                drawSolid(q, rgb, x0, x1, y0, y1);
+            }
+            else
+            {
+                drawTextured(q, rgb, x0, x1, y0, y1);
+            }
+        }
+    }
+
+    void drawSolid(const Quad &q, uint32_t rgb, int x0, int x1, int y0, int y1)
+    {
+        uint32_t alpha = unorm8(q.color.w);
+        for (int y = y0; y < y1; ++y)
+        {
+            uint32_t *row = &pixels[(size_t)y * width];
+            if (alpha == 255)
+            {
+                fill(row + x0, row + x1, rgb | 0xFF000000u);
+                continue;
+            }
+            for (int x = x0; x < x1; ++x)
+            {
+                row[x] = blend(row[x], rgb, alpha);
+            }
+        }
+    }
+
+    void drawTextured(const Quad &q, uint32_t rgb, int x0, int x1, int y0, int y1)
+    {
+        const SoftTexture &t = *q.texture;
+        int texHeight = (int)(t.pixels->size() / t.width);
+        vec2 extent = q.b - q.a;
+        vec2 duv = vec2(q.uv.z - q.uv.x, q.uv.w - q.uv.y);
+
+        // sprite_sdf.frag smooths over 0.7 fwidth of the distance. The field
+        // changes by 0.5 / spread per texel, and fwidth of a slanted edge is
+        // 1 to 1.4 times that per pixel, 1.2 is in between.
+        float smoothing = 0.0f;
+        if (t.distanceSpread > 0.0f)
+        {
+            float texelsPerPixel = std::max(fabsf(duv.x * t.width / extent.x), fabsf(duv.y * texHeight / extent.y));
+            smoothing = std::max(0.7f * 1.2f * texelsPerPixel * 0.5f / t.distanceSpread, 0.001f);
+        }
+
+        for (int y = y0; y < y1; ++y)
+        {
+            uint32_t *row = &pixels[(size_t)y * width];
+            float v = q.uv.y + duv.y * ((y + 0.5f - q.a.y) / extent.y);
+            for (int x = x0; x < x1; ++x)
+            {
+                float u = q.uv.x + duv.x * ((x + 0.5f - q.a.x) / extent.x);
+                float value = sample(t, texHeight, u, v);
+                float alpha = value;
+                if (smoothing > 0.0f)
+                {
+                    float k = std::clamp((value - (0.5f - smoothing)) / (2.0f * smoothing), 0.0f, 1.0f);
+                    alpha = k * k * (3.0f - 2.0f * k);
+                }
+                uint32_t a = unorm8(alpha);
+                if (a != 0)
+                    row[x] = blend(row[x], rgb, a);
+            }
+        }
+    }
+};
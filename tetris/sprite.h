@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+using namespace glm;
+
+#define SOLID 1.0
+#define TRANSPARENT 0.0
+
+// plain render data, kept free of GL headers so the simulation core can build sprites headless
+struct Sprite
+{
+    vec3 position;
+    vec2 size;
+    vec4 color;
+
+    unsigned int textureId;
+    vec4 uv = vec4(0.0f, 0.0f, 1.0f, 1.0f); // (u0, v0, u1, v1) of the texture
+};
+
+// where sprites are drawn, a GL context or the cpu rasterizer in soft_renderer.h
+enum RenderBackend
+{
+    RENDER_GL,
+    RENDER_SOFTWARE,
+};
+
+// texture ids for cpu side textures, kept clear of the small ids glGenTextures hands out
+inline unsigned int nextSoftTextureId()
+{
+    static unsigned int next = 0x40000000u;
+    return next++;
+}
@@ -4,16 +4,19 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <span>
+#include <vector>
+#include <stddef.h>
 
 #include "logger.h"
+#include "sprite.h"
+#include "stream_buffer.h"
 
 using namespace std;
 using namespace glm;
 
-#define SOLID 1.0
-#define TRANSPARENT 0.0
-
-string readFile(string fileName)
+inline string readFile(string fileName)
 {
     ifstream inFile;
     inFile.open(fileName); // open the input file
@@ -25,7 +28,7 @@ string readFile(string fileName)
     return str;
 }
 
-unsigned int createShader(string &vertexShaderSource, string &fragmentShaderSource)
+inline unsigned int createShader(string &vertexShaderSource, string &fragmentShaderSource)
 {
     unsigned int vertexShader;
     vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -83,24 +86,46 @@ unsigned int createShader(string &vertexShaderSource, string &fragmentShaderSour
     return shaderProgram;
 }
 
-
-struct Sprite
+// per sprite data in the instance buffer, the quad itself is shared
+struct SpriteInstance
 {
     vec3 position;
     vec2 size;
     vec4 color;
+    vec4 uv;
+};
 
-    GLuint textureId;
+#define SPRITE_INSTANCE_MIN_CAPACITY 1024
+
+// how a texture's texels turn into a fragment, one program each
+enum SpriteShader
+{
+    SHADER_COVERAGE,       // sprite.frag, the red channel is coverage
+    SHADER_DISTANCE_FIELD, // sprite_sdf.frag, the red channel is a distance field
+    SHADER_CELLS,          // board.frag, every texel is the rgba of a board cell
+    SPRITE_SHADER_COUNT,
+};
+
+struct SpriteProgram
+{
+    int id;
+    int viewLoc, projLoc;
 };
 
 class SpriteRenderer
 {
 public:
-    int VAO, VBO;
-    int spriteShader;
+    unsigned int VAO, VBO;
+    StreamBuffer instanceStream;
+    SpriteProgram programs[SPRITE_SHADER_COUNT];
     unsigned int dummyTextureId;
 
-    SpriteRenderer()
+    // since the last beginFrame()
+    int drawCalls = 0;
+    int spritesDrawn = 0;
+
+    SpriteRenderer(StreamMode streamMode = STREAM_MAP_UNSYNCHRONIZED)
+        : instanceStream(SPRITE_INSTANCE_MIN_CAPACITY * sizeof(SpriteInstance), streamMode)
     {
         float vertices[] = {
             0.0f, 0.0f, // bot left
@@ -109,11 +134,9 @@ public:
             1.0f, 1.0f,   // top right
         };
 
-        unsigned int VAO;
         glGenVertexArrays(1, &VAO);
         glBindVertexArray(VAO);
 
-        unsigned int VBO;
         glGenBuffers(1, &VBO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -121,15 +144,30 @@ public:
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
 
+        // one SpriteInstance per sprite, advanced once per quad
+        glBindBuffer(GL_ARRAY_BUFFER, instanceStream.buffer);
+        for (int i = 1; i <= 4; ++i)
+        {
+            glEnableVertexAttribArray(i);
+            glVertexAttribDivisor(i, 1);
+        }
+        setInstanceOffset(0);
+
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
 
         string vertexShaderSource = readFile("resources/shader/sprite.vert");
-        string fragmentShaderSource = readFile("resources/shader/sprite.frag");
-
-        this->spriteShader = createShader(vertexShaderSource, fragmentShaderSource);
-        this->VAO = VAO;
-        this->VBO = VBO;
+        const char *fragmentShaders[SPRITE_SHADER_COUNT] = {
+            "resources/shader/sprite.frag",
+            "resources/shader/sprite_sdf.frag",
+            "resources/shader/board.frag",
+        };
+        for (int i = 0; i < SPRITE_SHADER_COUNT; ++i)
+        {
+            string fragmentShaderSource = readFile(fragmentShaders[i]);
+            int id = createShader(vertexShaderSource, fragmentShaderSource);
+            programs[i] = SpriteProgram{id, glGetUniformLocation(id, "view"), glGetUniformLocation(id, "projection")};
+        }
 
         // generate a dummy texture here
         glGenTextures(1, &dummyTextureId);
@@ -142,37 +180,115 @@ public:
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
-    void render(vector<Sprite> sprites, mat4 view, mat4 proj)
+    // batches of this texture are drawn with shader instead of sprite.frag
+    void setTextureShader(unsigned int textureId, SpriteShader shader)
     {
-        glUseProgram(spriteShader);
-        glBindVertexArray(VAO);
+        for (auto &entry : textureShaders)
+        {
+            if (entry.first == textureId)
+            {
+                entry.second = shader;
+                return;
+            }
+        }
+        textureShaders.push_back({textureId, shader});
+    }
+
+    // stats restart here, and this frame's instances go to a region the gpu is done with
+    void beginFrame()
+    {
+        drawCalls = 0;
+        spritesDrawn = 0;
+        instanceStream.nextRegion();
+    }
 
-        int viewLoc = glGetUniformLocation(spriteShader, "view");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &view[0][0]);
+    // Sprites are grouped by texture, keeping their order inside a group,
+    // and every group is one instanced draw. Sprites with different textures
+    // should not rely on overlapping each other in list order.
+    void render(span<const Sprite> sprites, mat4 view, mat4 proj)
+    {
+        if (sprites.empty())
+            return;
 
-        int projLoc = glGetUniformLocation(spriteShader, "projection");
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, &proj[0][0]);
+        order.resize(sprites.size());
+        for (size_t i = 0; i < sprites.size(); ++i)
+        {
+            order[i] = (int)i;
+        }
+        // the index breaks ties, stable_sort would take a heap buffer every call
+        sort(order.begin(), order.end(), [&](int a, int b) {
+            return sprites[a].textureId != sprites[b].textureId ? sprites[a].textureId < sprites[b].textureId : a < b;
+        });
 
-        for (auto &sprite : sprites)
+        instances.resize(sprites.size());
+        for (size_t i = 0; i < sprites.size(); ++i)
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = translate(model, sprite.position);
-            model = scale(model, glm::vec3(sprite.size.x, sprite.size.y, 1.0f));
+            const Sprite &s = sprites[order[i]];
+            instances[i] = SpriteInstance{s.position, s.size, s.color, s.uv};
+        }
 
-            int modelLoc = glGetUniformLocation(spriteShader, "model");
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &model[0][0]);
+        glBindVertexArray(VAO);
+        int program = -1;
 
-            int colorLoc = glGetUniformLocation(spriteShader, "color");
-            glUniform4fv(colorLoc, 1, &sprite.color[0]);
+        size_t base = instanceStream.upload(instances.data(), instances.size() * sizeof(SpriteInstance));
 
-            // render glyph texture over quad
-            if(sprite.textureId == 0) {
-                glBindTexture(GL_TEXTURE_2D, dummyTextureId);
-            } else {
-                glBindTexture(GL_TEXTURE_2D, sprite.textureId);
+        size_t first = 0;
+        while (first < instances.size())
+        {
+            unsigned int textureId = sprites[order[first]].textureId;
+            size_t last = first + 1;
+            while (last < instances.size() && sprites[order[last]].textureId == textureId)
+            {
+                last++;
             }
 
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            int batchProgram = shaderFor(textureId);
+            if (batchProgram != program)
+            {
+                program = batchProgram;
+                const SpriteProgram &p = programs[program];
+                glUseProgram(p.id);
+                glUniformMatrix4fv(p.viewLoc, 1, GL_FALSE, &view[0][0]);
+                glUniformMatrix4fv(p.projLoc, 1, GL_FALSE, &proj[0][0]);
+            }
+            glBindTexture(GL_TEXTURE_2D, textureId == 0 ? dummyTextureId : textureId);
+            setInstanceOffset(base + first * sizeof(SpriteInstance));
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)(last - first));
+            drawCalls++;
+
+            first = last;
+        }
+        spritesDrawn += (int)instances.size();
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+private:
+    vector<SpriteInstance> instances;
+    vector<int> order;
+    vector<pair<unsigned int, SpriteShader>> textureShaders; // a handful at most
+
+    SpriteShader shaderFor(unsigned int textureId) const
+    {
+        for (const auto &entry : textureShaders)
+        {
+            if (entry.first == textureId)
+                return entry.second;
         }
+        return SHADER_COVERAGE;
+    }
+
+    // GL 3.3 has no base instance, so each batch points the attributes at its first instance
+    void setInstanceOffset(size_t base)
+    {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                              (void *)(base + offsetof(SpriteInstance, position)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                              (void *)(base + offsetof(SpriteInstance, size)));
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                              (void *)(base + offsetof(SpriteInstance, color)));
+        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                              (void *)(base + offsetof(SpriteInstance, uv)));
     }
 };
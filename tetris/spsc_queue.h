@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+
+using namespace std;
+
+// Bounded ring for one producer thread and one consumer thread. push() and
+// pop() finish in a fixed number of steps whatever the other side does, so
+// the producer can be a window system callback that must never block. A
+// full queue drops the value and counts it rather than waiting.
+template <typename T, size_t N> class SpscQueue
+{
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    atomic<size_t> dropped{0};
+
+    // producer side
+    bool push(const T &value)
+    {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == N)
+        {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+        items[t & (N - 1)] = value;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool pop(T &value)
+    {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire))
+            return false;
+        value = items[h & (N - 1)];
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    T items[N];
+    // running counts, the slot is the count modulo N
+    alignas(64) atomic<size_t> head{0};
+    alignas(64) atomic<size_t> tail{0};
+};
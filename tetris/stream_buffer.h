@@ -0,0 +1,162 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <chrono>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+using namespace std;
+
+#define STREAM_BUFFER_REGIONS 3
+#define STREAM_BUFFER_ALIGNMENT 64
+
+enum StreamMode
+{
+    // glMapBufferRange with UNSYNCHRONIZED | INVALIDATE_RANGE, a fence per region
+    // tells when the gpu is done reading it
+    STREAM_MAP_UNSYNCHRONIZED,
+    // glBufferData(NULL) on every nextRegion(), the driver hands out fresh
+    // storage and keeps the old one alive until the gpu is done with it
+    STREAM_ORPHAN,
+};
+
+// One buffer split into regions that are written in turn. Uploads append to
+// the current region, nextRegion() (once per frame) fences it and moves on, and
+// a region is only written again once its fence says the gpu has consumed it.
+// Plain GL 3.3 core, sync objects have been core since 3.2.
+class StreamBuffer
+{
+public:
+    unsigned int buffer;
+    StreamMode mode;
+    size_t regionSize;
+
+    // times the cpu had to wait for a region the gpu was still reading,
+    // and how long it waited in total
+    uint64_t stalls = 0;
+    double stallMs = 0.0;
+    uint64_t rotations = 0;
+    uint64_t reallocations = 0; // an upload bigger than a region grows every region
+    uint64_t bytesUploaded = 0;
+
+    StreamBuffer(size_t regionSize, StreamMode mode = STREAM_MAP_UNSYNCHRONIZED) : mode(mode), regionSize(regionSize)
+    {
+        glGenBuffers(1, &buffer);
+        allocate();
+    }
+
+    ~StreamBuffer()
+    {
+        dropFences();
+        glDeleteBuffers(1, &buffer);
+    }
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    // Copies data into the buffer and returns its byte offset. The buffer is
+    // left bound to GL_ARRAY_BUFFER. Offsets stay valid until the region is
+    // reused, STREAM_BUFFER_REGIONS - 1 rotations later.
+    size_t upload(const void *data, size_t bytes)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (bytes > regionSize)
+        {
+            while (regionSize < bytes)
+            {
+                regionSize *= 2;
+            }
+            allocate();
+            reallocations++;
+        }
+        else if (cursor + bytes > regionSize)
+        {
+            nextRegion();
+        }
+        if (cursor == 0)
+            waitForRegion();
+
+        size_t offset = region * regionSize + cursor;
+        if (mode == STREAM_MAP_UNSYNCHRONIZED)
+        {
+            void *dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes,
+                                         GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            memcpy(dst, data, bytes);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        else
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+        }
+
+        cursor = (cursor + bytes + STREAM_BUFFER_ALIGNMENT - 1) & ~(size_t)(STREAM_BUFFER_ALIGNMENT - 1);
+        bytesUploaded += bytes;
+        return offset;
+    }
+
+    // fences whatever was drawn from the current region and moves to the next one
+    void nextRegion()
+    {
+        if (cursor == 0)
+            return;
+        cursor = 0;
+        rotations++;
+
+        if (mode == STREAM_ORPHAN)
+        {
+            // always region 0, of whatever storage the driver hands back
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, regionSize * STREAM_BUFFER_REGIONS, nullptr, GL_STREAM_DRAW);
+            return;
+        }
+        if (fences[region] != nullptr)
+            glDeleteSync(fences[region]);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % STREAM_BUFFER_REGIONS;
+    }
+
+private:
+    GLsync fences[STREAM_BUFFER_REGIONS] = {};
+    int region = 0;
+    size_t cursor = 0;
+
+    // new storage, nothing the gpu still reads can be overwritten
+    void allocate()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, regionSize * STREAM_BUFFER_REGIONS, nullptr, GL_STREAM_DRAW);
+        dropFences();
+        region = 0;
+        cursor = 0;
+    }
+
+    void dropFences()
+    {
+        for (GLsync &f : fences)
+        {
+            if (f != nullptr)
+                glDeleteSync(f);
+            f = nullptr;
+        }
+    }
+
+    void waitForRegion()
+    {
+        GLsync fence = fences[region];
+        if (fence == nullptr)
+            return;
+        // a zero timeout only polls, anything else means the cpu got ahead of the gpu
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            stalls++;
+            auto start = chrono::steady_clock::now();
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            {
+            }
+            stallMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+        glDeleteSync(fence);
+        fences[region] = nullptr;
+    }
+};
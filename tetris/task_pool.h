@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+// Work-stealing thread pool. Every worker owns a deque, runs its own tasks
+// newest first and, once it runs dry, steals the oldest task of another
+// worker. Uneven task lengths then even out without a shared queue.
+class TaskPool
+{
+public:
+    atomic<uint64_t> steals;
+
+    TaskPool(int threadCount) : steals(0), pending(0), stopping(false), nextWorker(0)
+    {
+        if (threadCount < 1)
+            threadCount = 1;
+        for (int i = 0; i < threadCount; ++i)
+        {
+            workers.push_back(make_unique<Worker>());
+        }
+        for (int i = 0; i < threadCount; ++i)
+        {
+            threads.emplace_back(&TaskPool::workerLoop, this, i);
+        }
+    }
+
+    ~TaskPool()
+    {
+        {
+            lock_guard<mutex> lock(wakeMtx);
+            stopping = true;
+        }
+        wakeCv.notify_all();
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+    }
+
+    int size() const
+    {
+        return (int)workers.size();
+    }
+
+    // tasks are dealt round robin, stealing takes care of the imbalance
+    void submit(function<void()> task)
+    {
+        pending.fetch_add(1);
+        Worker &w = *workers[nextWorker.fetch_add(1) % workers.size()];
+        {
+            lock_guard<mutex> lock(w.mtx);
+            w.tasks.push_back(move(task));
+        }
+        {
+            lock_guard<mutex> lock(wakeMtx);
+            submitted.fetch_add(1);
+        }
+        wakeCv.notify_one();
+    }
+
+    // blocks until every submitted task has finished
+    void wait()
+    {
+        unique_lock<mutex> lock(wakeMtx);
+        doneCv.wait(lock, [this] { return pending.load() == 0; });
+    }
+
+private:
+    struct Worker
+    {
+        mutex mtx;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    atomic<int> pending;
+    bool stopping;
+    atomic<unsigned> nextWorker;
+
+    mutex wakeMtx;
+    condition_variable wakeCv;
+    condition_variable doneCv;
+    // bumped under wakeMtx after every push, a worker that saw it change since its scan has work to look for
+    atomic<uint64_t> submitted = 0;
+
+    bool popOwn(int index, function<void()> &task)
+    {
+        Worker &w = *workers[index];
+        lock_guard<mutex> lock(w.mtx);
+        if (w.tasks.empty())
+            return false;
+        task = move(w.tasks.back());
+        w.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int thief, function<void()> &task)
+    {
+        for (int i = 1; i < (int)workers.size(); ++i)
+        {
+            Worker &victim = *workers[(thief + i) % workers.size()];
+            lock_guard<mutex> lock(victim.mtx);
+            if (victim.tasks.empty())
+                continue;
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steals.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(int index)
+    {
+        function<void()> task;
+        while (true)
+        {
+            uint64_t seen = submitted.load();
+            if (popOwn(index, task) || steal(index, task))
+            {
+                task();
+                task = nullptr;
+                if (pending.fetch_sub(1) == 1)
+                {
+                    lock_guard<mutex> lock(wakeMtx);
+                    doneCv.notify_all();
+                }
+                continue;
+            }
+
+            unique_lock<mutex> lock(wakeMtx);
+            wakeCv.wait(lock, [&] { return stopping || submitted.load() != seen; });
+            if (stopping && submitted.load() == seen)
+                return;
+        }
+    }
+};
@@ -1,150 +1,30 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <array>
 #include <vector>
-#include <deque>
 #include <limits>
-#include <memory>
-#include <unordered_set>
+#include <optional>
 #include <algorithm>
+#include <bit>
 
-#include <time.h>
-#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
-#include "sprite_renderer.h"
+#include "sprite.h"
+#include "bitboard.h"
+#include "piece_table.h"
+#include "rng.h"
+#include "zobrist.h"
 
 using namespace std;
 using namespace glm;
 
-#define ARENA_SIZE_X 10
-#define ARENA_SIZE_Y 24
 #define ARENA_HIDDEN_HEIGHT 4
 #define BLOCKS_IN_QUEUE 3
+#define GHOST_ALPHA 0.25
 
-//[TYPE][ROTATION][I][J]
-static const vector<vector<vector<vector<int>>>> templates{
-#define TYPE_Z 0
-    {{
-         {0, 0, 0, 0},
-         {0, 1, 1, 0},
-         {0, 0, 1, 1},
-         {0, 0, 0, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 1, 0},
-         {0, 1, 1, 0},
-         {0, 1, 0, 0},
-     }},
-#define TYPE_Z_ALT 1
-    {{
-         {0, 0, 0, 0},
-         {0, 0, 1, 1},
-         {0, 1, 1, 0},
-         {0, 0, 0, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 1, 0, 0},
-         {0, 1, 1, 0},
-         {0, 0, 1, 0},
-     }},
-#define TYPE_I 2
-    {{
-         {0, 0, 1, 0},
-         {0, 0, 1, 0},
-         {0, 0, 1, 0},
-         {0, 0, 1, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 0, 0},
-         {1, 1, 1, 1},
-         {0, 0, 0, 0},
-     }},
-#define TYPE_BOX 3
-    {{
-        {0, 0, 0, 0},
-        {0, 1, 1, 0},
-        {0, 1, 1, 0},
-        {0, 0, 0, 0},
-    }},
-#define TYPE_L 4
-    {{
-         {0, 0, 0, 0},
-         {0, 1, 0, 0},
-         {0, 1, 0, 0},
-         {0, 1, 1, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 0, 0},
-         {0, 1, 1, 1},
-         {0, 1, 0, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 1, 1, 0},
-         {0, 0, 1, 0},
-         {0, 0, 1, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 0, 0},
-         {0, 0, 1, 0},
-         {1, 1, 1, 0},
-     }},
-#define TYPE_L_ALT 5
-    {{
-         {0, 0, 0, 0},
-         {0, 0, 1, 0},
-         {0, 0, 1, 0},
-         {0, 1, 1, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 0, 0},
-         {1, 1, 1, 0},
-         {0, 0, 1, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 1, 1, 0},
-         {0, 1, 0, 0},
-         {0, 1, 0, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 0, 0},
-         {0, 1, 0, 0},
-         {0, 1, 1, 1},
-     }},
-#define TYPE_T 6
-    {{
-         {0, 0, 0, 0},
-         {0, 1, 0, 0},
-         {0, 1, 1, 0},
-         {0, 1, 0, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 0, 0},
-         {0, 1, 1, 1},
-         {0, 0, 1, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 1, 0},
-         {0, 1, 1, 0},
-         {0, 0, 1, 0},
-     },
-     {
-         {0, 0, 0, 0},
-         {0, 0, 1, 0},
-         {0, 1, 1, 1},
-         {0, 0, 0, 0},
-     }}
-    /***/};
+static_assert(BLOCKS_IN_QUEUE < ZOBRIST_SEQUENCE_SLOTS, "every queue slot needs zobrist keys");
 
 class Block
 {
@@ -153,15 +33,15 @@ public:
     int rotation;
     vec3 color;
 
-    static Block randomOne()
+    static Block randomOne(Rng &rng)
     {
         Block b;
-        b.type = rand() % templates.size();
-        b.rotation = rand() % templates[b.type].size();
+        b.type = rng.nextInt(PIECE_TYPES);
+        b.rotation = rng.nextInt(PIECE_ROTATIONS[b.type]);
         b.color = vec3(
-            ((float)(rand() % 256) / 255),
-            ((float)(rand() % 256) / 255),
-            ((float)(rand() % 256) / 255));
+            ((float)rng.nextInt(256) / 255),
+            ((float)rng.nextInt(256) / 255),
+            ((float)rng.nextInt(256) / 255));
         return b;
     }
 
@@ -169,33 +49,40 @@ public:
     {
         Block b;
         b.type = type;
-        b.rotation = (rotation + 1) % templates[type].size();
+        b.rotation = (rotation + 1) % PIECE_ROTATIONS[type];
         b.color = color;
         return b;
     }
 
     void rotate()
     {
-        rotation = (rotation + 1) % templates[type].size();
+        rotation = (rotation + 1) % PIECE_ROTATIONS[type];
     }
 
-    vector<Sprite> render(vec2 blockSize)
+    bool sameAs(const Block &other) const
     {
-        vector<Sprite> sprites;
-        vector<vector<int>> blocks = templates[type][rotation];
-        for (int i = 0; i < blocks.size(); ++i)
+        return type == other.type && rotation == other.rotation && color == other.color;
+    }
+
+    const PieceShape &shape() const
+    {
+        return PIECES[type][rotation];
+    }
+
+    const PieceMask &mask() const
+    {
+        return shape().mask;
+    }
+
+    // one sprite per cell, by value since a piece always has PIECE_CELLS of them
+    array<Sprite, PIECE_CELLS> render(vec2 blockSize)
+    {
+        array<Sprite, PIECE_CELLS> sprites;
+        for (int i = 0; i < PIECE_CELLS; ++i)
         {
-            for (int j = 0; j < blocks[i].size(); ++j)
-            {
-                if (blocks[i][j] == 1)
-                {
-                    vec2 pos = vec2(j, i) * blockSize;
-                    sprites.push_back(
-                        {vec3(pos, 0.0),
-                         blockSize,
-                         vec4(color, 0.0)});
-                }
-            }
+            const PieceCell &c = shape().cells[i];
+            vec2 pos = vec2(c.x, c.y) * blockSize;
+            sprites[i] = Sprite{vec3(pos, 0.0), blockSize, vec4(color, 0.0)};
         }
         return sprites;
     }
@@ -210,15 +97,57 @@ class SelectedBlockChangeListener
 public:
     virtual void onChange(ivec2 topLeftPosition, Block *b) = 0;
 
-    virtual void onPlace(Block *b, unordered_set<int> *checkY) = 0;
+    virtual void onPlace(Block *b, RowSet checkY) = 0;
 };
 
-struct ArenaBlock
+// fixed capacity ring, refilling the preview queue never touches the heap
+class BlockQueue
 {
 public:
-    bool isPlaced;
-    bool isFilled;
-    vec3 color;
+    Block blocks[BLOCKS_IN_QUEUE];
+    int head = 0;
+    int count = 0;
+
+    int size() const
+    {
+        return count;
+    }
+
+    Block &front()
+    {
+        return blocks[head];
+    }
+
+    Block &operator[](int i)
+    {
+        return blocks[(head + i) % BLOCKS_IN_QUEUE];
+    }
+
+    const Block &operator[](int i) const
+    {
+        return blocks[(head + i) % BLOCKS_IN_QUEUE];
+    }
+
+    void push_back(const Block &b)
+    {
+        blocks[(head + count) % BLOCKS_IN_QUEUE] = b;
+        count++;
+    }
+
+    void pop_front()
+    {
+        head = (head + 1) % BLOCKS_IN_QUEUE;
+        count--;
+    }
+};
+
+// what drawing an arena needs, copied out by the thread that simulates it
+struct ArenaSnapshot
+{
+    BitBoard board;
+    optional<Block> selected;
+    ivec2 selectedIndex;
+    BlockQueue next;
 };
 
 class Arena
@@ -226,17 +155,32 @@ class Arena
 public:
     vec2 position;
     vec2 size;
-    deque<Block> next;
+    BlockQueue next;
     SelectedBlockChangeListener *sbcl;
 
-    vec2 selectedIndex;
-    unique_ptr<Block> selected;
+    ivec2 selectedIndex;
+    optional<Block> selected;
 
-    ArenaBlock blocks[ARENA_SIZE_Y][ARENA_SIZE_X];
+    BitBoard board;
+    Rng rng;
 
-    Arena(vec2 position, int sizeX)
+    // zobrist hash of the placed cells, the falling block and the queue
+    uint64_t hash;
+
+    // running totals, never reset by dead()
+    int linesCleared;
+    int piecesPlaced;
+    int deaths;
+
+    // sprites the render calls had to build rather than hand back from their caches, a running total
+    uint64_t spritesRegenerated = 0;
+
+    Arena(vec2 position, int sizeX, uint64_t seed) : rng(seed)
     {
         sbcl = nullptr;
+        linesCleared = 0;
+        piecesPlaced = 0;
+        deaths = 0;
         this->position = position;
         size.x = sizeX;
         vec2 b = getBlockSize();
@@ -244,35 +188,65 @@ public:
 
         fillNext();
         resetArena();
+
+        // every list at its largest up front, so a frame never grows one
+        for (vector<Sprite> &row : rowSprites)
+        {
+            row.reserve(ARENA_SIZE_X);
+        }
+        cellSprites.reserve(ARENA_SIZE_X * ARENA_SIZE_Y);
+        fallingSprites.reserve(PIECE_CELLS);
+        ghostSprites.reserve(PIECE_CELLS);
+        arenaSprites.reserve(ARENA_SIZE_X * ARENA_SIZE_Y + 2 * PIECE_CELLS);
+        previewSprites.reserve(BLOCKS_IN_QUEUE * PIECE_CELLS);
+        boundarySprites.reserve(3);
     }
 
     void resetArena()
     {
-        for (int i = 0; i < ARENA_SIZE_Y; ++i)
+        board.reset();
+        selected.reset();
+        hash = queueHash();
+    }
+
+    // from scratch, the incrementally kept hash must always equal this
+    uint64_t computeHash() const
+    {
+        uint64_t h = zobristRows(board.placed, 0, ARENA_SIZE_Y) ^ queueHash();
+        if (selected)
+            h ^= zobristFalling(selected->type, selected->rotation, selectedIndex);
+        return h;
+    }
+
+    uint64_t queueHash() const
+    {
+        uint64_t h = 0;
+        for (int i = 0; i < next.size(); ++i)
         {
-            for (int j = 0; j < ARENA_SIZE_X; ++j)
-            {
-                blocks[i][j] = ArenaBlock{false, false, vec3()};
-            }
+            h ^= ZOBRIST.sequence[i][next[i].type][next[i].rotation];
         }
-        selected = nullptr;
+        return h;
     }
 
     void fillNext()
     {
         while (next.size() < BLOCKS_IN_QUEUE)
         {
-            next.push_back(Block::randomOne());
+            next.push_back(Block::randomOne(rng));
+            previewStale = true;
         }
     }
 
+    // the new block is on the board right away, so every clearCurrentBlock has a matching place
     void selectNext()
     {
-        auto block = next.front();
+        hash ^= queueHash();
+        selected = next.front();
         next.pop_front();
-        selected = make_unique<Block>(Block(block)); // copy & own
-        selectedIndex = vec2(ARENA_SIZE_X / 2 - templates[selected->type][selected->rotation][0].size() / 2, 0);
+        selectedIndex = ivec2(selected->shape().spawnX, selected->shape().spawnY);
         fillNext();
+        hash ^= queueHash();
+        placeCurrentBlock();
     }
 
     vec2 getBlockSize()
@@ -281,86 +255,31 @@ public:
         return vec2(kx, kx);
     }
 
-    vector<ivec2> getSelectedIndex(Block *b, vec2 index)
-    {
-        vector<ivec2> indices;
-        if (b != nullptr)
-        {
-            auto block = templates[b->type][b->rotation];
-            for (int i = 0; i < block.size(); ++i)
-            {
-                for (int j = 0; j < block[i].size(); ++j)
-                {
-                    if (block[i][j] == 0)
-                        continue;
-                    int x = index.x + j;
-                    int y = index.y + i;
-                    indices.push_back(ivec2(x, y));
-                }
-            }
-        }
-        return indices;
-    }
-
     void moveHorizontal(bool isLeft, bool isRight)
     {
-        if (isLeft == isRight)
+        if (isLeft == isRight || !selected)
         {
             return;
         }
-        auto si = getSelectedIndex(selected.get(), selectedIndex);
 
-        if (isLeft)
+        ivec2 target = selectedIndex + ivec2(isLeft ? -1 : 1, 0);
+        if (board.collides(selected->mask(), target))
         {
-            bool canMoveLeft = true;
-            for (auto &s : si)
-            {
-                if (s.x - 1 < 0 || blocks[s.y][s.x - 1].isPlaced)
-                {
-                    canMoveLeft = false;
-                }
-            }
-            if (canMoveLeft)
-            {
-                clearCurrentBlock();
-                selectedIndex.x -= 1;
-                placeCurrentBlock();
-            }
-        }
-        if (isRight)
-        {
-            bool canMoveRight = true;
-            for (auto &s : si)
-            {
-                if (s.x + 1 >= ARENA_SIZE_X || blocks[s.y][s.x + 1].isPlaced)
-                {
-                    canMoveRight = false;
-                }
-            }
-            if (canMoveRight)
-            {
-                clearCurrentBlock();
-                selectedIndex.x += 1;
-                placeCurrentBlock();
-            }
+            return;
         }
+        clearCurrentBlock();
+        selectedIndex = target;
+        placeCurrentBlock();
     }
 
     void rotate()
     {
-        if (selected == nullptr)
+        if (!selected)
             return;
         Block rotated = selected->rotateCopy();
-        vector<ivec2> indices = getSelectedIndex(&rotated, selectedIndex);
-
-        for (auto &i : indices)
+        if (board.collides(rotated.mask(), selectedIndex))
         {
-            if (blocks[i.y][i.x].isPlaced ||
-                i.y < 0 || i.y >= ARENA_SIZE_Y ||
-                i.x < 0 || i.x >= ARENA_SIZE_X)
-            {
-                return;
-            }
+            return;
         }
         clearCurrentBlock();
         selected->rotate();
@@ -369,40 +288,34 @@ public:
 
     void moveDown()
     {
-        if (selected == nullptr)
+        if (!selected)
         {
             selectNext();
         }
 
-        bool shouldPlace = false;
-        auto si = getSelectedIndex(selected.get(), selectedIndex);
-        for (auto &s : si)
+        const PieceMask &mask = selected->mask();
+        if (board.collides(mask, selectedIndex + ivec2(0, 1)))
         {
-            if (s.y + 1 >= ARENA_SIZE_Y || blocks[s.y + 1][s.x].isPlaced)
+            for (int i = 0; i < 4; ++i)
             {
-                shouldPlace = true;
-                break;
-            }
-        }
-        if (shouldPlace)
-        {
-            unordered_set<int> checkY;
-            bool isDead = false;
-            for (auto &s : si)
-            {
-                blocks[s.y][s.x] = ArenaBlock{true, true, selected->color};
-                checkY.insert(s.y);
-                if (s.y < ARENA_HIDDEN_HEIGHT)
+                if (mask.rows[i] == 0)
+                    continue;
+                int y = selectedIndex.y + i;
+                if (y < ARENA_HIDDEN_HEIGHT)
                 {
                     dead();
                     return;
                 }
             }
+            hash ^= zobristFalling(selected->type, selected->rotation, selectedIndex);
+            hash ^= zobristPieceCells(selected->type, selected->rotation, selectedIndex);
+            RowSet checkY = board.place(mask, selectedIndex, packColor(selected->color));
+            piecesPlaced++;
             if(sbcl != nullptr){
-                sbcl->onPlace(selected.get(), &checkY);
+                sbcl->onPlace(&*selected, checkY);
             }
             scoreCheck(checkY);
-            selected = nullptr;
+            selected.reset();
             return;
         }
         else
@@ -414,103 +327,138 @@ public:
         }
     }
 
-    void clearCurrentBlock()
+    // Row the falling block would lock on if dropped straight down. Each cell
+    // can fall until the first placed cell below it in its own column, so this
+    // is one column lookup per cell instead of one collision test per row.
+    int landingRow() const
     {
-        auto si = getSelectedIndex(selected.get(), selectedIndex);
-        for (auto &s : si)
+        int drop = ARENA_SIZE_Y;
+        for (const PieceCell &c : selected->shape().cells)
         {
-            blocks[s.y][s.x] = ArenaBlock{false, false, selected->color};
+            drop = std::min(drop, board.freeBelow(selectedIndex.x + c.x, selectedIndex.y + c.y));
         }
+        return selectedIndex.y + drop;
     }
 
-    void placeCurrentBlock()
+    // drops the falling block to its landing row and locks it, returns the rows dropped
+    int hardDrop()
     {
-        auto si = getSelectedIndex(selected.get(), selectedIndex);
-        for (auto &s : si)
+        if (!selected)
+            return 0;
+        int drop = landingRow() - selectedIndex.y;
+        if (drop > 0)
         {
-            blocks[s.y][s.x] = ArenaBlock{false, true, selected->color};
+            clearCurrentBlock();
+            selectedIndex.y += drop;
+            placeCurrentBlock();
         }
+        moveDown(); // lock
+        return drop;
+    }
+
+    void clearCurrentBlock()
+    {
+        if (!selected)
+            return;
+        board.unfill(selected->mask(), selectedIndex);
+        hash ^= zobristFalling(selected->type, selected->rotation, selectedIndex);
+    }
+
+    void placeCurrentBlock()
+    {
+        if (!selected)
+            return;
+        board.fill(selected->mask(), selectedIndex, packColor(selected->color));
+        hash ^= zobristFalling(selected->type, selected->rotation, selectedIndex);
         if(sbcl != nullptr)
-            sbcl->onChange(selectedIndex, selected.get());
+            sbcl->onChange(selectedIndex, &*selected);
     }
 
     void dead()
     {
+        deaths++;
         resetArena();
     }
 
-    void scoreCheck(unordered_set<int> &checkY)
+    void scoreCheck(RowSet checkY)
     {
-        deque<int> lineYIndex;
-        unordered_set<int> ignorePullDownY;
-
-        // find complete lines
-        vector<int> sortedY(checkY.begin(), checkY.end());
-        sort(sortedY.begin(), sortedY.end(), greater<int>());
-        for (auto &y : sortedY)
+        RowSet lines = 0;
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
         {
-            bool hasALine = true;
-            for (int x = 0; x < ARENA_SIZE_X; ++x)
-            {
-                if (!blocks[y][x].isFilled)
-                {
-                    hasALine = false;
-                    break;
-                }
-            }
-
-            if (hasALine)
-            {
-                ignorePullDownY.insert(y);
-                lineYIndex.push_back(y);
-            }
+            if (((checkY >> y) & 1) && board.isLineFull(y))
+                lines |= 1u << y;
         }
+        linesCleared += popcount(lines);
 
-        // pull down
-        bool hasFoundEmptyRow = false;
-        while (!lineYIndex.empty())
-        {
-            int currY = lineYIndex.front();
-            lineYIndex.pop_front();
+        // only the rows down to the lowest cleared line move
+        int moved = bit_width(lines);
+        hash ^= zobristRows(board.placed, 0, moved);
+        board.clearLines(lines);
+        hash ^= zobristRows(board.placed, 0, moved);
+    }
+
+    void saveSnapshot(ArenaSnapshot &out) const
+    {
+        out.board = board;
+        out.selected = selected;
+        out.selectedIndex = selectedIndex;
+        out.next = next;
+    }
 
-            if (hasFoundEmptyRow)
+    // Makes this arena show another one's state, for an arena that only
+    // draws. Only the rows and the queue that really differ are rebuilt by
+    // the next render calls.
+    void loadSnapshot(const ArenaSnapshot &s)
+    {
+        RowSet changed = board.dirtyRows;
+        for (int y = 0; y < ARENA_SIZE_Y; ++y)
+        {
+            if (board.placed[y] != s.board.placed[y])
             {
-                for (int j = 0; j < ARENA_SIZE_X; ++j)
-                {
-                    blocks[currY][j] = ArenaBlock{false, false, vec3()};
-                }
+                changed |= 1u << y;
                 continue;
             }
-
-            for (int i = currY - 1; i >= 0; --i)
+            // the falling block leaves its color behind on the cells it passed, only placed ones count
+            for (RowMask m = board.placed[y]; m != 0; m &= m - 1)
             {
-                if (ignorePullDownY.find(i) != ignorePullDownY.end())
-                {
-                    continue;
-                }
-                int ec = 0;
-                for (int j = 0; j < ARENA_SIZE_X; ++j)
+                int x = countr_zero(m);
+                if (board.colors[y][x] != s.board.colors[y][x])
                 {
-                    if (!blocks[i][j].isFilled)
-                        ec++;
-                    blocks[currY][j] = blocks[i][j];
-                    blocks[i][j] = ArenaBlock{false, false, vec3()};
+                    changed |= 1u << y;
+                    break;
                 }
-                if (ec == ARENA_SIZE_X)
-                    hasFoundEmptyRow = true;
-                lineYIndex.push_back(i);
-                ignorePullDownY.insert(i);
-                break;
             }
         }
+        board = s.board;
+        board.dirtyRows = changed;
+        selected = s.selected;
+        selectedIndex = s.selectedIndex;
+
+        bool sameQueue = next.size() == s.next.size();
+        for (int i = 0; sameQueue && i < next.size(); ++i)
+        {
+            sameQueue = next[i].sameAs(s.next[i]);
+        }
+        previewStale |= !sameQueue;
+        next = s.next;
     }
 
-    vector<Sprite> renderPreview()
+    // The render calls below hand out sprite lists kept from earlier calls
+    // and only rebuild what changed since: the placed rows the BitBoard marked
+    // dirty, the falling block when it moved, the queue after fillNext() and
+    // everything when position or size moved. A frame where nothing happened
+    // builds no sprites at all.
+    const vector<Sprite> &renderPreview()
     {
+        collectChanges();
+        if (!previewStale)
+            return previewSprites;
+        previewStale = false;
+
         vec2 blockSize = getBlockSize();
         vec2 startPos = vec2(position.x + size.x, position.y + blockSize.y);
 
-        vector<Sprite> sprites;
+        previewSprites.clear();
         for (int i = 0; i < next.size(); ++i)
         {
             auto n = next[i].render(blockSize);
@@ -522,42 +470,157 @@ public:
                     startPos.x + blockSize.x * 2.0,
                     startPos.y,
                     0.0);
-                sprites.push_back(n[j]);
+                previewSprites.push_back(n[j]);
                 lowestY = std::max(lowestY, n[j].position.y + blockSize.y);
             }
 
             startPos.y = lowestY + blockSize.y;
         }
 
-        return sprites;
+        spritesRegenerated += previewSprites.size();
+        return previewSprites;
     }
 
-    vector<Sprite> render()
+    // the placed cells, the falling block drawn fallingOffset away from its cells, then the ghost
+    const vector<Sprite> &render(vec2 fallingOffset = vec2(0.0f))
     {
+        collectChanges();
+        if (!arenaStale && fallingOffset == arenaFallingOffset)
+            return arenaSprites;
+        arenaStale = false;
+        arenaFallingOffset = fallingOffset;
+
+        const vector<Sprite> &cells = renderCells();
+        const vector<Sprite> &falling = renderFalling(fallingOffset);
+        const vector<Sprite> &ghost = renderGhost();
+        arenaSprites.assign(cells.begin(), cells.end());
+        arenaSprites.insert(arenaSprites.end(), falling.begin(), falling.end());
+        arenaSprites.insert(arenaSprites.end(), ghost.begin(), ghost.end());
+        return arenaSprites;
+    }
+
+    // top left of row 0, the hidden rows sit above position
+    vec2 gridOrigin()
+    {
+        return vec2(position.x, position.y - ARENA_HIDDEN_HEIGHT * getBlockSize().y);
+    }
+
+    const vector<Sprite> &renderCells()
+    {
+        collectChanges();
+        if (staleRows == 0)
+            return cellSprites;
+
         vec2 blockSize = getBlockSize();
-        vec2 startPos = vec2(position.x, position.y - ARENA_HIDDEN_HEIGHT * blockSize.y);
+        vec2 startPos = gridOrigin();
 
-        vector<Sprite> sprites;
-        for (int i = 0; i < ARENA_SIZE_Y; ++i)
+        for (RowSet rows = staleRows; rows != 0; rows &= rows - 1)
         {
+            int i = countr_zero(rows);
+            vector<Sprite> &row = rowSprites[i];
+            row.clear();
             for (int j = 0; j < ARENA_SIZE_X; ++j)
             {
-                if (!blocks[i][j].isFilled)
+                if (!board.isPlaced(j, i))
                 {
                     continue;
                 }
-                sprites.push_back(Sprite{
+                row.push_back(Sprite{
                     vec3(startPos + vec2(j * blockSize.x, i * blockSize.y), 0.0),
                     vec2(blockSize),
-                    vec4(blocks[i][j].color, SOLID)});
+                    vec4(unpackColor(board.colors[i][j]), SOLID)});
             }
+            spritesRegenerated += row.size();
         }
+        staleRows = 0;
 
-        return sprites;
+        // rows that did not change are copied as they are
+        cellSprites.clear();
+        for (int i = 0; i < ARENA_SIZE_Y; ++i)
+        {
+            cellSprites.insert(cellSprites.end(), rowSprites[i].begin(), rowSprites[i].end());
+        }
+        return cellSprites;
     }
 
-    vector<Sprite> renderBoundary()
+    // the falling block, offset in pixels for drawing it on its way between two cells
+    const vector<Sprite> &renderFalling(vec2 offset = vec2(0.0f))
     {
+        collectChanges();
+        if (!fallingStale && offset == fallingOffset)
+            return fallingSprites;
+        fallingStale = false;
+        fallingOffset = offset;
+
+        vec2 blockSize = getBlockSize();
+        vec2 startPos = gridOrigin() + offset;
+
+        fallingSprites.clear();
+        if (selected)
+        {
+            for (const PieceCell &c : selected->shape().cells)
+            {
+                fallingSprites.push_back(Sprite{
+                    vec3(startPos + vec2((selectedIndex.x + c.x) * blockSize.x, (selectedIndex.y + c.y) * blockSize.y),
+                         0.0),
+                    vec2(blockSize),
+                    vec4(selected->color, SOLID)});
+            }
+        }
+
+        spritesRegenerated += fallingSprites.size();
+        return fallingSprites;
+    }
+
+    // ghost of the falling block where a hard drop would put it
+    const vector<Sprite> &renderGhost()
+    {
+        collectChanges();
+        if (!ghostStale)
+            return ghostSprites;
+        ghostStale = false;
+
+        vec2 blockSize = getBlockSize();
+        vec2 startPos = gridOrigin();
+
+        ghostSprites.clear();
+        if (selected)
+        {
+            int ghostY = landingRow();
+            for (const PieceCell &c : selected->shape().cells)
+            {
+                int x = selectedIndex.x + c.x;
+                int y = ghostY + c.y;
+                if (board.isFilled(x, y))
+                    continue;
+                ghostSprites.push_back(Sprite{
+                    vec3(startPos + vec2(x * blockSize.x, y * blockSize.y), 0.0),
+                    vec2(blockSize),
+                    vec4(selected->color, GHOST_ALPHA)});
+            }
+        }
+
+        spritesRegenerated += ghostSprites.size();
+        return ghostSprites;
+    }
+
+    // Every cell on one quad covering the whole grid, hidden rows included,
+    // for a texture holding the board like BoardTexture. Costs the same
+    // however full the board is.
+    Sprite renderBoard(unsigned int cellTextureId)
+    {
+        vec2 blockSize = getBlockSize();
+        return Sprite{vec3(gridOrigin(), 0.0), vec2(ARENA_SIZE_X * blockSize.x, ARENA_SIZE_Y * blockSize.y),
+                      vec4(1.0), cellTextureId, vec4(0.0f, 0.0f, 1.0f, 1.0f)};
+    }
+
+    const vector<Sprite> &renderBoundary()
+    {
+        collectChanges();
+        if (!boundaryStale)
+            return boundarySprites;
+        boundaryStale = false;
+
         // render the boundarys of the tetris arena
         vec2 blockSize = getBlockSize();
         vec2 halfBlockSize = blockSize / vec2(4.0);
@@ -569,10 +632,68 @@ public:
 
         vec4 color = vec4(vec3(1.0), SOLID);
 
-        return vector<Sprite>{
+        boundarySprites.assign({
             Sprite{vec3(topLeft, 0.0), vec2(halfBlockSize.x, size.y - ARENA_HIDDEN_HEIGHT * blockSize.y), color},
             Sprite{vec3(bottomLeft, 0.0), vec2(size.x + (blockSize.x - 2 * halfBlockSize.x), halfBlockSize.y), color},
             Sprite{vec3(topRight, 0.0), vec2(halfBlockSize.x, size.y - ARENA_HIDDEN_HEIGHT * blockSize.y), color},
-        };
+        });
+        spritesRegenerated += boundarySprites.size();
+        return boundarySprites;
     }
-};
\ No newline at end of file
+
+private:
+    vector<Sprite> rowSprites[ARENA_SIZE_Y];
+    vector<Sprite> cellSprites;
+    vector<Sprite> fallingSprites;
+    vector<Sprite> ghostSprites;
+    vector<Sprite> arenaSprites;
+    vector<Sprite> previewSprites;
+    vector<Sprite> boundarySprites;
+
+    // what the lists above still have to catch up on
+    RowSet staleRows = 0;
+    bool fallingStale = true;
+    bool ghostStale = true;
+    bool arenaStale = true;
+    bool previewStale = true;
+    bool boundaryStale = true;
+
+    // position and size the lists were built for
+    vec2 layoutPosition = vec2(-1.0f);
+    vec2 layoutSize = vec2(-1.0f);
+    vec2 fallingOffset = vec2(0.0f);
+    vec2 arenaFallingOffset = vec2(0.0f);
+
+    // the falling block the lists were built for
+    optional<Block> fallingBuilt;
+    ivec2 fallingBuiltIndex;
+
+    void collectChanges()
+    {
+        if (position != layoutPosition || size != layoutSize)
+        {
+            layoutPosition = position;
+            layoutSize = size;
+            board.dirtyRows = ((RowSet)1 << ARENA_SIZE_Y) - 1;
+            previewStale = true;
+            boundaryStale = true;
+            fallingStale = true;
+        }
+        bool moved = selected.has_value() != fallingBuilt.has_value() ||
+                     (selected && (!selected->sameAs(*fallingBuilt) || selectedIndex != fallingBuiltIndex));
+        if (moved)
+        {
+            fallingBuilt = selected;
+            fallingBuiltIndex = selectedIndex;
+            fallingStale = true;
+        }
+        RowSet rows = board.takeDirtyRows();
+        staleRows |= rows;
+        // the ghost lands on the placed rows and follows the falling block
+        if (rows != 0 || moved)
+        {
+            ghostStale = true;
+            arenaStale = true;
+        }
+    }
+};
@@ -2,34 +2,23 @@
 
 #include <glad/glad.h>
 #include <iostream>
+#include <span>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
-#include <ft2build.h>
-#include FT_FREETYPE_H
 
 #include "sprite_renderer.h"
+#include "glyph_atlas.h"
+#include "glyph_rasterizer.h"
+#include "text_run_cache.h"
+#include "frame_allocator.h"
 
 using namespace std;
 
-struct FontKey {
-    string fontName;
-
-    bool operator==(const FontKey& other) const {
-        return (fontName == other.fontName);
-    }
-};
-
-namespace std {
-    template <>
-    struct hash<FontKey> {
-        std::size_t operator()(const FontKey& k) const {
-            std::size_t h1 = std::hash<string>()(k.fontName);
-            return h1;
-        }
-    };
-}
+#define DEFAULT_FONT_SIZE 48
 
 struct FontCharacter {
     int width;
@@ -39,85 +28,319 @@ struct FontCharacter {
     int bearingX;
     int bearingY;
     GLuint textureId;
+    vec4 uv; // (u0, v0, u1, v1) in the atlas
 };
 
+// next codepoint of a utf-8 string, malformed bytes come out as U+FFFD
+inline uint32_t decodeUtf8(string_view text, size_t& i) {
+    unsigned char c = text[i++];
+    if (c < 0x80) {
+        return c;
+    }
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : -1;
+    if (extra < 0 || i + extra > text.size()) {
+        return 0xFFFD;
+    }
+    uint32_t codepoint = c & (0x3F >> extra);
+    for (int k = 0; k < extra; ++k) {
+        unsigned char next = text[i];
+        if ((next & 0xC0) != 0x80) {
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (next & 0x3F);
+        i++;
+    }
+    return codepoint;
+}
+
 class TextRenderer {
 public:
-    FT_Library library;
-    FT_Face face;
+    // freetype runs on its worker, the renderer only ever touches finished bitmaps
+    GlyphRasterizer rasterizer;
+    unordered_map<string, uint32_t> fontIds;
+
+    // every glyph lives in the one atlas texture, so all text is a single batch
+    unordered_map<GlyphKey, FontCharacter> glyphs;
+    GlyphAtlas atlas;
+    uint64_t atlasGeneration = 0; // bumped whenever cached uvs change or new glyphs land
+
+    // laid out runs for layoutTextCached
+    TextRunCache runCache;
 
-    /*FontKey => {
-        'A' => FontCharacter{ width, height, blabla },
-        'B' => ...
-    }*/
-    unordered_map<FontKey, unordered_map<string, FontCharacter>> fonts;
+    uint32_t defaultFont;
 
-    FontKey defaultFontKey;
+    // glyphs drawn blank since the last beginFrame() because they were still
+    // rasterizing, zero once everything on screen is in the atlas
+    int cacheMisses = 0;
+    uint64_t totalCacheMisses = 0;
+    int glyphsUploaded = 0; // by the last beginFrame()
+
+    TextRenderer(string path, GlyphMode mode = GLYPH_BITMAP, RenderBackend backend = RENDER_GL,
+                 const string& prewarmCharset = GLYPH_PREWARM_CHARSET, int prewarmSize = DEFAULT_FONT_SIZE)
+        : rasterizer(mode), atlas(backend) {
+        defaultFont = loadFont(path);
+        prewarm(prewarmCharset, prewarmSize);
+    }
 
-    TextRenderer(string path) {
-        if(FT_Init_FreeType(&library)){
-            throw runtime_error("unable to load FT_Init_FreeType");
+    uint32_t loadFont(string path) {
+        auto it = fontIds.find(path);
+        if(it != fontIds.end()) {
+            return it->second;
         }
-        if(FT_New_Face(library, path.c_str(), 0 , &face)) {
-            throw runtime_error("unable to load FT_New_Face");
+        uint32_t id = rasterizer.loadFont(path);
+        fontIds[path] = id;
+        return id;
+    }
+
+    GlyphMode mode() const {
+        return rasterizer.mode;
+    }
+
+    // queues the glyphs of charset without waiting for them
+    void prewarm(const string& charset, int size = DEFAULT_FONT_SIZE) {
+        size_t i = 0;
+        while(i < charset.size()) {
+            requestGlyph(GlyphKey{defaultFont, rasterSize(size), decodeUtf8(charset, i)});
         }
-        FT_Set_Pixel_Sizes(face, 0, 48);  
+    }
 
-        defaultFontKey = FontKey{path};
+    // distance fields are rasterized at one size whatever size the text is drawn at
+    uint32_t rasterSize(int size) const {
+        return rasterizer.mode == GLYPH_SDF ? GLYPH_SDF_SIZE : (uint32_t)size;
+    }
+
+    // uploads whatever the worker finished since the last frame
+    void beginFrame() {
+        cacheMisses = 0;
+        uploadGlyphs();
+    }
 
-        fonts[defaultFontKey] = {};
+    // blocks until every requested glyph is in the atlas, for tools and benchmarks
+    void waitForGlyphs() {
+        rasterizer.waitIdle();
+        uploadGlyphs();
     }
 
-    vector<Sprite> layoutText(vec3 originPos, string text, vec3 color) {
-        if(fonts.find(defaultFontKey) == fonts.end()) {
-            return {};
+    // nullptr when the glyph is still rasterizing or cannot be rendered
+    const FontCharacter* glyph(uint32_t font, int size, uint32_t codepoint) {
+        GlyphKey key{font, rasterSize(size), codepoint};
+        auto it = glyphs.find(key);
+        if(it != glyphs.end()) {
+            return &it->second;
         }
+        if(!failed.count(key)) {
+            requestGlyph(key);
+            cacheMisses++;
+            totalCacheMisses++;
+        }
+        return nullptr;
+    }
 
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        
-        //gives 0 shit about unicode for now
+    // glyphs still rasterizing are left out, the text fills in once they land
+    vector<Sprite> layoutText(vec3 originPos, string_view text, vec3 color, int size = DEFAULT_FONT_SIZE) {
         vector<Sprite> sprites;
-        for(int i = 0; i < text.size(); ++i) {
-            if(fonts[defaultFontKey].find(string(&text[i])) == fonts[defaultFontKey].end()){
-                if(FT_Load_Char(face, text[i], FT_LOAD_RENDER)){
-                    cout << "unable to render " << text[i] << " glyph" << endl;
+        layoutText(sprites, originPos, text, color, size);
+        return sprites;
+    }
+
+    // into sprites, reusing what it already holds
+    void layoutText(vector<Sprite>& sprites, vec3 originPos, string_view text, vec3 color, int size = DEFAULT_FONT_SIZE) {
+        sprites.resize(text.size());
+        sprites.resize(layoutInto(sprites.data(), originPos, text, color, size));
+    }
+
+    // for text that changes every frame, laid out into memory the frame owns
+    span<const Sprite> layoutText(FrameAllocator& frame, vec3 originPos, string_view text, vec3 color, int size = DEFAULT_FONT_SIZE) {
+        span<Sprite> sprites = frame.allocate<Sprite>(text.size());
+        return sprites.first(layoutInto(sprites.data(), originPos, text, color, size));
+    }
+
+    // Same as layoutText into the frame, but a run laid out before is copied
+    // from the cache instead. The copy belongs to the frame, so runs the
+    // cache evicts later in the frame stay valid until it is reset.
+    span<const Sprite> layoutTextCached(FrameAllocator& frame, vec3 originPos, string_view text, vec3 color, int size = DEFAULT_FONT_SIZE) {
+        const vector<Sprite>* cached = runCache.find(text, defaultFont, size, color, originPos, atlasGeneration);
+        if(cached != nullptr) {
+            span<Sprite> sprites = frame.allocate<Sprite>(cached->size());
+            copy(cached->begin(), cached->end(), sprites.begin());
+            return sprites;
+        }
+        span<const Sprite> sprites = layoutText(frame, originPos, text, color, size);
+        runCache.put(TextRunKey{string(text), defaultFont, size, color, originPos}, atlasGeneration,
+                     vector<Sprite>(sprites.begin(), sprites.end()));
+        return sprites;
+    }
+
+private:
+    // at most one sprite per byte of text goes to out, returns how many
+    size_t layoutInto(Sprite* out, vec3 originPos, string_view text, vec3 color, int size) {
+        if(rasterizer.mode == GLYPH_SDF) {
+            return layoutScaled(out, originPos, text, color, size);
+        }
+        size_t count = 0;
+        size_t i = 0;
+        while(i < text.size()) {
+            const FontCharacter* fc = glyph(defaultFont, size, decodeUtf8(text, i));
+            if(fc == nullptr) {
+                continue;
+            }
+            if(fc->width > 0 && fc->height > 0) {
+                float x = originPos.x + fc->bearingX;
+                float y = originPos.y - fc->bearingY;
+                out[count++] = Sprite{vec3(x, y, originPos.z), vec2(fc->width, fc->height), vec4(color,SOLID), fc->textureId, fc->uv};
+            }
+            originPos.x += (fc->advanceX >> 6);
+        }
+
+        return count;
+    }
+
+    // distance field glyphs scaled from GLYPH_SDF_SIZE, metrics stay fractional
+    size_t layoutScaled(Sprite* out, vec3 originPos, string_view text, vec3 color, int size) {
+        float scale = (float)size / GLYPH_SDF_SIZE;
+        size_t count = 0;
+        size_t i = 0;
+        while(i < text.size()) {
+            const FontCharacter* fc = glyph(defaultFont, size, decodeUtf8(text, i));
+            if(fc == nullptr) {
+                continue;
+            }
+            if(fc->width > 0 && fc->height > 0) {
+                float x = originPos.x + fc->bearingX * scale;
+                float y = originPos.y - fc->bearingY * scale;
+                out[count++] = Sprite{vec3(x, y, originPos.z), vec2(fc->width, fc->height) * scale, vec4(color,SOLID), fc->textureId, fc->uv};
+            }
+            originPos.x += fc->advanceX / 64.0f * scale;
+        }
+
+        return count;
+    }
+
+    // requested from the worker, not in glyphs yet
+    unordered_set<GlyphKey> loading;
+    // freetype could not render these, asking again would not help
+    unordered_set<GlyphKey> failed;
+    vector<RasterizedGlyph> staged;
+
+    void requestGlyph(GlyphKey key) {
+        if(glyphs.count(key) || !loading.insert(key).second) {
+            return;
+        }
+        rasterizer.request(key);
+    }
+
+    void uploadGlyphs() {
+        glyphsUploaded = 0;
+        rasterizer.takeFinished(staged);
+        if(staged.empty()) {
+            return;
+        }
+
+        for(RasterizedGlyph& g : staged) {
+            loading.erase(g.key);
+            if(!g.ok) {
+                cout << "unable to render " << g.key.codepoint << " glyph" << endl;
+                failed.insert(g.key);
+                continue;
+            }
+            FontCharacter fc = {
+                g.width, g.height,
+                g.advanceX, g.advanceY,
+                g.bearingX, g.bearingY,
+                atlas.textureId, vec4(0.0f),
+            };
+            if(fc.width > 0 && fc.height > 0) {
+                int before = atlas.height();
+                if(!atlas.add(g.pixels.data(), fc.width, fc.height, fc.width, fc.uv)) {
+                    cout << "glyph atlas is full" << endl;
+                    failed.insert(g.key);
                     continue;
                 }
-                int width = face->glyph->bitmap.width;
-                int height = face->glyph->bitmap.rows;
-
-                // Create an OpenGL texture object from the glyph bitmap
-                GLuint textureId;
-                glGenTextures(1, &textureId);
-                glBindTexture(GL_TEXTURE_2D, textureId);
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                
-                fonts[defaultFontKey][string(&text[i])] = FontCharacter {
-                    width, height, 
-                    (int) face->glyph->advance.x, (int) face->glyph->advance.y,
-                    (int) face->glyph->bitmap_left, (int) face->glyph->bitmap_top,
-                    textureId,
-                };
+                if(atlas.height() != before) {
+                    // uvs handed out by add() so far are relative to the old height
+                    rescaleUvs((float)before / atlas.height());
+                }
             }
-            FontCharacter fc = fonts[defaultFontKey][string(&text[i])];    
-            float x = originPos.x + fc.bearingX;
-            float y = originPos.y - fc.bearingY;
-        
-            sprites.push_back(Sprite{vec3(x, y, originPos.z), vec2(fc.width, fc.height), vec4(color,SOLID), fc.textureId});
-            
-            originPos.x += (fc.advanceX >> 6);
+            glyphs[g.key] = fc;
+            glyphsUploaded++;
         }
+        staged.clear();
 
-        return sprites;
+        // text laid out while these were blank is out of date
+        atlasGeneration++;
     }
 
-    ~TextRenderer() {
-        FT_Done_Face(face);
-        FT_Done_FreeType(library);
+    // the atlas grew taller, every v shrinks by the same factor
+    void rescaleUvs(float scale) {
+        for(auto& entry : glyphs) {
+            entry.second.uv.y *= scale;
+            entry.second.uv.w *= scale;
+        }
+        atlasGeneration++;
     }
+};
+
+// Retained text for labels drawn every frame. Only a new string or size lays
+// it out again, moving or recoloring it patches the sprites it already has.
+class TextObject {
+public:
+    // times the text was laid out, stays put while the content does
+    int layouts = 0;
 
-};
\ No newline at end of file
+    TextObject(TextRenderer* renderer, vec3 origin, vec3 color, int size = DEFAULT_FONT_SIZE)
+        : renderer(renderer), origin(origin), color(color), size(size) {
+    }
+
+    void setText(const string& text) {
+        if(text != this->text) {
+            this->text = text;
+            dirty = true;
+        }
+    }
+
+    void setSize(int size) {
+        if(size != this->size) {
+            this->size = size;
+            dirty = true;
+        }
+    }
+
+    void setOrigin(vec3 origin) {
+        vec3 delta = origin - this->origin;
+        for(Sprite& s : laidOut) {
+            s.position += delta;
+        }
+        this->origin = origin;
+    }
+
+    void setColor(vec3 color) {
+        for(Sprite& s : laidOut) {
+            s.color = vec4(color, s.color.w);
+        }
+        this->color = color;
+    }
+
+    const string& getText() const {
+        return text;
+    }
+
+    const vector<Sprite>& sprites() {
+        if(dirty || generation != renderer->atlasGeneration) {
+            renderer->layoutText(laidOut, origin, text, color, size);
+            generation = renderer->atlasGeneration;
+            dirty = false;
+            layouts++;
+        }
+        return laidOut;
+    }
+
+private:
+    TextRenderer* renderer;
+    string text;
+    vec3 origin;
+    vec3 color;
+    int size;
+    bool dirty = true;
+    uint64_t generation = 0;
+    vector<Sprite> laidOut;
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+
+#include "sprite.h"
+
+using namespace std;
+using namespace glm;
+
+#define TEXT_RUN_CACHE_MAX_SPRITES 16384
+
+// everything a laid out run depends on
+struct TextRunKey
+{
+    string text;
+    uint32_t font;
+    int size;
+    vec3 color;
+    vec3 origin;
+};
+
+inline uint64_t hashFloatBits(uint64_t h, float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    h ^= bits;
+    h *= 0x100000001B3ull;
+    return h ^ (h >> 29);
+}
+
+inline uint64_t hashTextRun(string_view text, uint32_t font, int size, vec3 color, vec3 origin)
+{
+    uint64_t h = hash<string_view>()(text) ^ ((uint64_t)font << 40) ^ ((uint64_t)(uint32_t)size << 8);
+    for (float f : {color.x, color.y, color.z, origin.x, origin.y, origin.z})
+    {
+        h = hashFloatBits(h, f);
+    }
+    return h;
+}
+
+// Laid out sprite runs, least recently used first out once the cached runs
+// hold more than maxSprites sprites. Lookups hash the key fields in place,
+// so a hit never allocates.
+class TextRunCache
+{
+public:
+    struct Run
+    {
+        uint64_t hash;
+        TextRunKey key;
+        uint64_t atlasGeneration; // runs laid out against an older atlas have stale uvs
+        vector<Sprite> sprites;
+    };
+
+    size_t maxSprites;
+    size_t spriteCount = 0;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    explicit TextRunCache(size_t maxSprites = TEXT_RUN_CACHE_MAX_SPRITES) : maxSprites(maxSprites)
+    {
+    }
+
+    // the cached run, or nullptr when it has to be laid out and put(), only
+    // valid until the next put() or clear() since those may evict it
+    const vector<Sprite> *find(string_view text, uint32_t font, int size, vec3 color, vec3 origin,
+                               uint64_t atlasGeneration)
+    {
+        uint64_t h = hashTextRun(text, font, size, color, origin);
+        auto it = index.find(h);
+        if (it == index.end() || !sameKey(it->second->key, text, font, size, color, origin) ||
+            it->second->atlasGeneration != atlasGeneration)
+        {
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        runs.splice(runs.begin(), runs, it->second);
+        return &it->second->sprites;
+    }
+
+    void put(TextRunKey key, uint64_t atlasGeneration, vector<Sprite> sprites)
+    {
+        uint64_t h = hashTextRun(key.text, key.font, key.size, key.color, key.origin);
+        auto it = index.find(h);
+        if (it != index.end())
+        {
+            remove(it->second);
+        }
+
+        spriteCount += sprites.size();
+        runs.push_front(Run{h, move(key), atlasGeneration, move(sprites)});
+        index[h] = runs.begin();
+
+        // the run just added always stays, even when it alone is over budget
+        while (spriteCount > maxSprites && runs.size() > 1)
+        {
+            remove(prev(runs.end()));
+            evictions++;
+        }
+    }
+
+    size_t size() const
+    {
+        return runs.size();
+    }
+
+    void clear()
+    {
+        runs.clear();
+        index.clear();
+        spriteCount = 0;
+    }
+
+private:
+    list<Run> runs; // most recently used first
+    unordered_map<uint64_t, list<Run>::iterator> index;
+
+    static bool sameKey(const TextRunKey &k, string_view text, uint32_t font, int size, vec3 color, vec3 origin)
+    {
+        return k.text == text && k.font == font && k.size == size && k.color == color && k.origin == origin;
+    }
+
+    void remove(list<Run>::iterator run)
+    {
+        spriteCount -= run->sprites.size();
+        index.erase(run->hash);
+        runs.erase(run);
+    }
+};
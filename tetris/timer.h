@@ -1,73 +1,53 @@
 #pragma once
+#include <stdint.h>
 
 using namespace std;
 
+// Auto repeat on the simulation clock, in microseconds. Fires
+// firstStickyTimerLimit after start(), then every timerLimit for as long as
+// it stays started. The caller asks due() with the time it has reached and
+// calls exec() for each repeat, so repeats land at their exact time rather
+// than on the tick or frame they fall in.
 class Timer
 {
 public:
-    float isStarted;
-    float currTimer;
-    float currTimerLimit;
+    bool isStarted;
+    int64_t nextExec; // when the next repeat is due
 
-    float execCount;
+    int64_t timerLimit;
+    int64_t firstStickyTimerLimit; // first timer used after start
 
-    float timerLimit;
-    float firstStickyTimerLimit; // first timer used after start
-
-    Timer(float timerLimit) : timerLimit(timerLimit), firstStickyTimerLimit(timerLimit)
+    Timer(int64_t timerLimit) : timerLimit(timerLimit), firstStickyTimerLimit(timerLimit)
     {
         stop();
     }
 
-    Timer(float timerLimit, float firstStickyTimerLimit) : timerLimit(timerLimit),
-                                                           firstStickyTimerLimit(firstStickyTimerLimit)
+    Timer(int64_t timerLimit, int64_t firstStickyTimerLimit) : timerLimit(timerLimit),
+                                                               firstStickyTimerLimit(firstStickyTimerLimit)
     {
         stop();
     }
 
-    void addExec(int count)
-    {
-        execCount += count;
-    }
-
-    void start()
+    void start(int64_t time)
     {
         isStarted = true;
+        nextExec = time + firstStickyTimerLimit;
     }
 
     void stop()
     {
         isStarted = false;
-        currTimer = 0.0f;
-        execCount = 0.0f;
-        currTimerLimit = firstStickyTimerLimit;
+        nextExec = 0;
     }
 
-    void tick(float deltaTime)
+    // a repeat is due before time
+    bool due(int64_t time) const
     {
-        if (!isStarted)
-            return;
-        currTimer += deltaTime;
-        if (currTimer >= currTimerLimit)
-        {
-            currTimer -= currTimerLimit;
-            int overLimit = 1;
-            currTimerLimit = timerLimit; // force back to non sticky after first tick;
-
-            if(currTimer > currTimerLimit) {
-                overLimit += floor(currTimer / currTimerLimit);
-                float leftOver = currTimer - (overLimit * currTimerLimit);
-                currTimer = leftOver;
-            }
-
-            execCount += overLimit;
-        }
+        return isStarted && nextExec < time;
     }
 
-    int consumeExec()
+    void exec()
     {
-        int e = execCount;
-        execCount = 0;
-        return e;
+        nextExec += timerLimit;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "bot.h"
+#include "rng.h"
+#include "task_pool.h"
+#include "tetris.h"
+
+using namespace std;
+
+struct TournamentConfig
+{
+    int games;
+    int threads;
+    int maxPieces; // a game also ends here, good bots rarely die
+    int lookahead;
+    int tableMegabytes; // transposition table per worker, 0 for none
+    uint64_t seed;
+    string outPath;
+};
+
+#pragma pack(push, 1)
+// one record per game in the output file, right after the header
+struct TournamentResult
+{
+    uint64_t seed;
+    uint32_t lines;
+    uint32_t pieces;
+    uint32_t durationUs;
+};
+
+struct TournamentHeader
+{
+    char magic[4]; // "TTRN"
+    uint32_t version;
+    uint32_t games;
+    uint32_t recordSize;
+};
+#pragma pack(pop)
+
+inline TournamentResult playTournamentGame(uint64_t seed, int maxPieces, int lookahead, int tableMegabytes)
+{
+    // one table per worker thread, reused by every game it plays
+    thread_local unique_ptr<TranspositionTable> table;
+    if (tableMegabytes > 0 && !table)
+        table = make_unique<TranspositionTable>(tableMegabytes);
+
+    auto start = chrono::steady_clock::now();
+
+    Arena arena(vec2(0.0f, 0.0f), 300, seed);
+    HeuristicEvaluator evaluator;
+    // no real budget, a deadline would make results depend on machine load
+    Bot bot(&evaluator, lookahead, 60000.0);
+    if (tableMegabytes > 0)
+        bot.table = table.get();
+    while (arena.deaths == 0 && arena.piecesPlaced < maxPieces)
+    {
+        bot.play(arena);
+    }
+
+    auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    return TournamentResult{seed, (uint32_t)arena.linesCleared, (uint32_t)arena.piecesPlaced, (uint32_t)us};
+}
+
+inline int runTournament(const TournamentConfig &config)
+{
+    vector<TournamentResult> results(config.games);
+    Rng seeds(config.seed);
+    vector<uint64_t> gameSeeds(config.games);
+    for (auto &s : gameSeeds)
+    {
+        s = seeds.next();
+    }
+
+    cout << "tournament: " << config.games << " games on " << config.threads << " threads, seed "
+         << config.seed << endl;
+
+    auto start = chrono::steady_clock::now();
+    uint64_t steals;
+    {
+        TaskPool pool(config.threads);
+        for (int i = 0; i < config.games; ++i)
+        {
+            pool.submit([&, i]() {
+                results[i] = playTournamentGame(gameSeeds[i], config.maxPieces, config.lookahead,
+                                                config.tableMegabytes);
+            });
+        }
+        pool.wait();
+        steals = pool.steals.load();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    uint64_t pieces = 0;
+    uint64_t lines = 0;
+    for (auto &r : results)
+    {
+        pieces += r.pieces;
+        lines += r.lines;
+    }
+
+    ofstream out(config.outPath, ios::binary);
+    if (!out)
+    {
+        cout << "unable to write " << config.outPath << endl;
+        return -1;
+    }
+    TournamentHeader header = {{'T', 'T', 'R', 'N'}, 1, (uint32_t)config.games, sizeof(TournamentResult)};
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)results.data(), results.size() * sizeof(TournamentResult));
+
+    cout << "games/sec.........: " << config.games / elapsed << endl;
+    cout << "pieces/sec........: " << (uint64_t)(pieces / elapsed) << endl;
+    cout << "lines per game....: " << (double)lines / config.games << endl;
+    cout << "steals............: " << steals << endl;
+    cout << "results...........: " << config.outPath << endl;
+    return 0;
+}
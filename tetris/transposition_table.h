@@ -0,0 +1,125 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+using namespace std;
+
+#define TT_BUCKET_ENTRIES 4
+
+struct TranspositionEntry
+{
+    uint64_t key;
+    float score;
+    uint8_t depth;      // pieces placed below this position, 0 for an empty entry
+    uint8_t generation; // search that stored it
+    uint8_t padding[2];
+};
+
+// one cache line, a probe never touches more than one
+struct alignas(64) TranspositionBucket
+{
+    TranspositionEntry entries[TT_BUCKET_ENTRIES];
+};
+static_assert(sizeof(TranspositionBucket) == 64, "a bucket should be exactly one cache line");
+
+// Fixed size hash table of search results keyed by zobrist hash. Replacement
+// prefers entries left over from older searches, then the shallowest one,
+// since a deep result saved more work than a shallow one.
+class TranspositionTable
+{
+public:
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+    uint64_t stores = 0;
+    uint64_t replacements = 0; // stores that evicted a live entry
+
+    // the bucket count is rounded down to a power of two that fits the budget
+    explicit TranspositionTable(size_t megabytes)
+    {
+        size_t count = 1;
+        while (count * 2 * sizeof(TranspositionBucket) <= megabytes * 1024 * 1024)
+        {
+            count *= 2;
+        }
+        buckets.resize(count);
+        mask = count - 1;
+        clear();
+    }
+
+    void clear()
+    {
+        for (TranspositionBucket &b : buckets)
+        {
+            b = TranspositionBucket{};
+        }
+        generation = 0;
+    }
+
+    // call once per think(), older entries become the first to go
+    void newSearch()
+    {
+        generation++;
+    }
+
+    bool probe(uint64_t key, float &score)
+    {
+        probes++;
+        TranspositionBucket &b = buckets[key & mask];
+        for (TranspositionEntry &e : b.entries)
+        {
+            if (e.key == key && e.depth != 0)
+            {
+                e.generation = generation;
+                score = e.score;
+                hits++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void store(uint64_t key, float score, int depth)
+    {
+        stores++;
+        TranspositionBucket &b = buckets[key & mask];
+        TranspositionEntry *victim = nullptr;
+        int victimCost = 1 << 30;
+        for (TranspositionEntry &e : b.entries)
+        {
+            if (e.key == key || e.depth == 0)
+            {
+                victim = &e;
+                break;
+            }
+            uint8_t age = generation - e.generation;
+            int cost = e.depth - 16 * age;
+            if (cost < victimCost)
+            {
+                victim = &e;
+                victimCost = cost;
+            }
+        }
+        if (victim->depth != 0 && victim->key != key)
+            replacements++;
+        victim->key = key;
+        victim->score = score;
+        victim->depth = (uint8_t)depth;
+        victim->generation = generation;
+    }
+
+    double hitRate() const
+    {
+        return probes == 0 ? 0.0 : (double)hits / probes;
+    }
+
+    size_t bytes() const
+    {
+        return buckets.size() * sizeof(TranspositionBucket);
+    }
+
+private:
+    vector<TranspositionBucket> buckets;
+    uint64_t mask;
+    uint8_t generation;
+};
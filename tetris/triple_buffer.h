@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+using namespace std;
+
+// One writer thread hands whole values to one reader thread without either
+// ever waiting on the other. The writer fills writeBuffer() and publish()es
+// it, the reader fetch()es the newest published value and reads it from
+// readBuffer() for as long as it likes. Values published in between are
+// skipped, the reader only ever sees complete ones.
+template <typename T> class TripleBuffer
+{
+public:
+    TripleBuffer() : middle(1), back(0), front(2)
+    {
+    }
+
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // writer side
+    T &writeBuffer()
+    {
+        return slots[back];
+    }
+
+    void publish()
+    {
+        back = middle.exchange(back | FRESH, memory_order_acq_rel) & INDEX;
+    }
+
+    // reader side, true when a value newer than the last one fetched arrived
+    bool fetch()
+    {
+        if ((middle.load(memory_order_relaxed) & FRESH) == 0)
+            return false;
+        front = middle.exchange(front, memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T &readBuffer() const
+    {
+        return slots[front];
+    }
+
+private:
+    static const uint8_t INDEX = 3;
+    static const uint8_t FRESH = 4; // set on middle by publish(), cleared by fetch()
+
+    T slots[3];
+    // the slot neither side holds, swapped with back on publish and with front on fetch
+    alignas(64) atomic<uint8_t> middle;
+    alignas(64) uint8_t back;  // writer only
+    alignas(64) uint8_t front; // reader only
+};
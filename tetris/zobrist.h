@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "piece_table.h"
+
+using namespace std;
+
+// slots of a piece sequence with their own keys, the preview queue or the bot's lookahead
+#define ZOBRIST_SEQUENCE_SLOTS 8
+#define ZOBRIST_MAX_LINES (4 * ZOBRIST_SEQUENCE_SLOTS)
+
+// One random key per feature of a position, the hash is the xor of the keys of
+// every feature present. Generated at compile time from a fixed seed, so hashes
+// are the same in every build and on every machine.
+struct ZobristKeys
+{
+    uint64_t cells[ARENA_SIZE_Y][ARENA_SIZE_X];
+
+    // the falling block, its top left is stored with x + 4 like the collision lanes
+    uint64_t selected[PIECE_TYPES][PIECE_MAX_ROTATIONS];
+    uint64_t position[ARENA_SIZE_Y][32];
+
+    uint64_t sequence[ZOBRIST_SEQUENCE_SLOTS][PIECE_TYPES][PIECE_MAX_ROTATIONS];
+    uint64_t lines[ZOBRIST_MAX_LINES + 1];
+
+    constexpr ZobristKeys() : cells(), selected(), position(), sequence(), lines()
+    {
+        uint64_t state = 0x5A0B7157C0FFEEull;
+        for (auto &row : cells)
+            for (uint64_t &k : row)
+                k = splitMix(state);
+        for (auto &type : selected)
+            for (uint64_t &k : type)
+                k = splitMix(state);
+        for (auto &row : position)
+            for (uint64_t &k : row)
+                k = splitMix(state);
+        for (auto &slot : sequence)
+            for (auto &type : slot)
+                for (uint64_t &k : type)
+                    k = splitMix(state);
+        for (uint64_t &k : lines)
+            k = splitMix(state);
+    }
+
+    static constexpr uint64_t splitMix(uint64_t &state)
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+constexpr ZobristKeys ZOBRIST;
+
+inline uint64_t zobristRow(int y, RowMask row)
+{
+    uint64_t h = 0;
+    while (row != 0)
+    {
+        h ^= ZOBRIST.cells[y][countr_zero(row)];
+        row &= row - 1;
+    }
+    return h;
+}
+
+// rows [from, to)
+inline uint64_t zobristRows(const RowMask *rows, int from, int to)
+{
+    uint64_t h = 0;
+    for (int y = from; y < to; ++y)
+    {
+        h ^= zobristRow(y, rows[y]);
+    }
+    return h;
+}
+
+// the cells a piece covers with the top left of its template at topLeft
+inline uint64_t zobristPieceCells(int type, int rotation, ivec2 topLeft)
+{
+    uint64_t h = 0;
+    for (const PieceCell &c : PIECES[type][rotation].cells)
+    {
+        h ^= ZOBRIST.cells[topLeft.y + c.y][topLeft.x + c.x];
+    }
+    return h;
+}
+
+inline uint64_t zobristFalling(int type, int rotation, ivec2 topLeft)
+{
+    return ZOBRIST.selected[type][rotation] ^ ZOBRIST.position[topLeft.y][topLeft.x + 4];
+}